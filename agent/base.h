@@ -175,7 +175,7 @@ struct BaseAgent : std::enable_shared_from_this<BaseAgent> {
 
     // Check if the agent is stuck in a loop by detecting duplicate content
     bool is_stuck() {
-        const std::vector<Message>& messages = memory->get_messages();
+        const auto& messages = memory->messages_view();
 
         if (messages.size() < duplicate_threshold) {
             return false;
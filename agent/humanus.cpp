@@ -97,8 +97,12 @@ Humanus Humanus::load_from_toml(const toml::table& config_table) {
         }
         
         std::shared_ptr<Memory> memory = nullptr;
-        if (config_table.contains("memory")) {
-            memory = std::make_shared<Memory>(Config::get_memory_config(config_table["memory"].as_string()->get()));
+        if (config_table.contains("memory") || config_table.contains("tenant")) {
+            auto memory_config = Config::get_memory_config(config_table["memory"].value_or("default"));
+            if (config_table.contains("tenant")) {
+                memory_config.tenant = config_table["tenant"].as_string()->get();
+            }
+            memory = std::make_shared<Memory>(memory_config);
         }
 
         int max_steps = 30;
@@ -188,8 +192,12 @@ Humanus Humanus::load_from_json(const json& config_json) {
         }
         
         std::shared_ptr<Memory> memory = nullptr;
-        if (config_json.contains("memory")) {
-            memory = std::make_shared<Memory>(Config::get_memory_config(config_json["memory"].get<std::string>()));
+        if (config_json.contains("memory") || config_json.contains("tenant")) {
+            auto memory_config = Config::get_memory_config(config_json.value("memory", "default"));
+            if (config_json.contains("tenant")) {
+                memory_config.tenant = config_json["tenant"].get<std::string>();
+            }
+            memory = std::make_shared<Memory>(memory_config);
         }
 
         int max_steps = 30;
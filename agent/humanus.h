@@ -22,16 +22,7 @@ namespace humanus {
  */
 struct Humanus : ToolCallAgent {
     Humanus(
-        const ToolCollection& available_tools = ToolCollection( // Add general-purpose tools to the tool collection
-            {
-                std::make_shared<PythonExecute>(),
-                std::make_shared<Filesystem>(),
-                std::make_shared<Playwright>(),
-                std::make_shared<ImageLoader>(),
-                std::make_shared<ContentProvider>(),
-                std::make_shared<Terminate>()
-            }
-        ),
+        const ToolCollection& available_tools = default_tools(),
         const std::string& name = "humanus",
         const std::string& description = "A versatile agent that can solve various tasks using multiple tools",
         const std::string& system_prompt = prompt::humanus::SYSTEM_PROMPT,
@@ -54,6 +45,25 @@ struct Humanus : ToolCallAgent {
             duplicate_threshold
         ) {}
 
+    // Default agent on `memory` (e.g. a tenant partition), no default memory is created and discarded first
+    explicit Humanus(const std::shared_ptr<BaseMemory>& memory)
+        : Humanus(default_tools(), "humanus", "A versatile agent that can solve various tasks using multiple tools",
+                  prompt::humanus::SYSTEM_PROMPT, prompt::humanus::NEXT_STEP_PROMPT, nullptr, memory) {}
+
+    // General-purpose tools
+    static ToolCollection default_tools() {
+        return ToolCollection(
+            {
+                std::make_shared<PythonExecute>(),
+                std::make_shared<Filesystem>(),
+                std::make_shared<Playwright>(),
+                std::make_shared<ImageLoader>(),
+                std::make_shared<ContentProvider>(),
+                std::make_shared<Terminate>()
+            }
+        );
+    }
+
     std::string run(const std::string& request = "") override;
 
     static Humanus load_from_toml(const toml::table& config_table);
@@ -70,7 +70,8 @@ std::string ToolCallAgent::act() {
         }
 
         // Return last message content if no tool calls
-        return memory->get_messages().empty() || memory->get_messages().back().content.empty() ? "No content or commands to execute" : memory->get_messages().back().content.dump();
+        const Message* last_message = memory->last_message();
+        return !last_message || last_message->content.empty() ? "No content or commands to execute" : last_message->content.dump();
     }
 
     std::vector<ToolResult> results;
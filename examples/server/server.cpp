@@ -29,7 +29,7 @@ public:
             return it->second;
         }
         
-        auto agent = std::make_shared<Humanus>();
+        auto agent = std::make_shared<Humanus>(); // Shares long-term memory across sessions, see `tenant` of humanus_initialize
         agents_[session_id] = agent;
 
         return agent;
@@ -132,6 +132,7 @@ int main(int argc, char** argv) {
                     .with_description("Initialize the agent")
                     .with_string_param("llm", "The LLM configuration to use. Default: default")
                     .with_string_param("memory", "The memory configuration to use. Default: default")
+                    .with_string_param("tenant", "The long-term memory partition, persisted until removed from the vector store path. Default: empty, memories are shared across sessions")
                     .with_array_param("tools", "The tools of the agent. Default: filesystem, playwright (for browser use), image_loader, content_provider, terminate", "string")
                     .with_array_param("mcp_servers", "The MCP servers offering tools for the agent. Default: python_execute", "string")
                     .with_number_param("max_steps", "The maximum steps of the agent. Default: 30")
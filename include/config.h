@@ -163,13 +163,22 @@ enum class EmbeddingType {
 };
 
 struct EmbeddingModelConfig {
-    std::string provider = "oai";
+    std::string provider = "oai";          // "oai" (OpenAI-compatible HTTP API) or "local" (in-process GGUF model)
     std::string base_url = "http://localhost:8080";
     std::string endpoint = "/v1/embeddings";
     std::string model = "nomic-embed-text-v1.5.f16.gguf";
     std::string api_key = "";
     int embedding_dims = 768;
     int max_retries = 3;
+    std::string encoding_format = "float"; // "float" or "base64" (smaller payload, no decimal parsing)
+    int max_batch_size = 32;               // Maximum number of inputs per request
+    int max_batch_tokens = 8192;           // Maximum number of (estimated) tokens per request
+    int batch_window_ms = 0;               // Collect requests across callers for up to this long (0 to disable)
+    int cache_size = 0;                    // Maximum number of embeddings kept in the in-memory LRU cache (0 to disable)
+    std::string cache_path = "";           // Optional file to persist cached embeddings across restarts
+    int cache_file_size = 65536;           // Maximum number of embeddings kept in `cache_path` (0 for unbounded)
+    std::string model_path = "";           // GGUF weights for the local provider
+    int num_threads = 0;                   // Threads used by the local provider (0 for all cores)
 
     static EmbeddingModelConfig load_from_toml(const toml::table& config_table);
 };
@@ -181,11 +190,33 @@ struct VectorStoreConfig {
     int M = 16;                      // Tightly connected with internal dimensionality of the data
                                      // strongly affects the memory consumption
     int ef_construction = 200;       // Controls index search speed/build speed tradeoff
+    int ef_search = 64;              // Candidate list size of searches (at least `limit`), controls recall / search speed tradeoff
+    float recall_target = 0.0f;      // Adjust `ef_search` to the smallest value keeping this recall@k (0 to disable)
+    int recall_sample_interval = 100; // Repeat every this many searches exactly to measure the recall
+    int max_elements_per_tenant = 0; // Capacity of each tenant partition (0 to use max_elements)
+    std::string path = "";           // Directory to persist the store in (empty to keep it in memory only)
+    int snapshot_interval = 1024;    // Write a snapshot (and truncate the write-ahead log) after this many operations
     enum class Metric {
         L2,
-        IP
+        IP,
+        COSINE                       // Normalized on insert / query and compared by inner product, so that
+                                     // `MemoryItem::score` is 1 - cosine similarity (like 1 - dot product for IP)
     };
     Metric metric = Metric::L2;
+    enum class Quantization {
+        NONE,
+        FP16,
+        INT8
+    };
+    Quantization quantization = Quantization::NONE; // Element type of the index, FP16 / INT8 make it 2x / ~4x smaller
+    int rerank_factor = 0;           // Re-rank `rerank_factor * limit` quantized candidates at full precision
+                                     // (0 to disable, otherwise float copies of the vectors are kept as well)
+    int auto_threshold = 4096;       // Provider "auto": exact scan up to this many vectors, HNSW beyond
+    int filter_scan_threshold = 2048; // Filtered searches scan the matching vectors exactly if at most this many
+                                     // are estimated to match
+    int memory_budget_mb = 0;        // Grow the capacity beyond `max_elements` while the index fits into this many MiB
+                                     // (0 to evict the least recently used memories at `max_elements` instead)
+    float compaction_threshold = 0.3f; // Rebuild the graph in the background once this fraction of it is deleted (0 to disable)
 
     static VectorStoreConfig load_from_toml(const toml::table& config_table);
 };
@@ -197,10 +228,25 @@ struct MemoryConfig {
     int max_tokens_messages = 1 << 16;      // Maximum number of tokens in short-term memory
     int max_tokens_context = 1 << 17;       // Maximum number of tokens in context (used by `get_messages`)
     int retrieval_limit = 32;               // Maximum number of results to retrive from long-term memory
+    std::string tenant = "";                // Long-term memory partition ("" for the store shared by all memories)
+    float update_distance_threshold = -1.0f; // Existing memories farther than this (vector store distance) are not sent
+                                            // to the update step, new facts are added directly (negative to disable)
+
+    // Consolidation config
+    bool async_consolidation = true;        // Extract facts from evicted messages on a background worker
+    int max_pending_consolidations = 8;     // `add_message` blocks while this many batches are waiting (backpressure)
+    int consolidation_batch_messages = 1;   // Coalesce evicted messages until this many are pending...
+    int consolidation_batch_tokens = 0;     // ...or they reach this many tokens (0 to disable)...
+    int consolidation_window_ms = 0;        // ...or the oldest has waited this long (0 to disable)
+
+    // Summary config
+    bool rolling_summary = false;           // Also fold evicted messages into a running summary kept in short-term memory
+    int max_tokens_summary = 2048;          // Maximum number of tokens in the summary
 
     // Prompt config
     std::string fact_extraction_prompt = prompt::FACT_EXTRACTION_PROMPT;
     std::string update_memory_prompt = prompt::UPDATE_MEMORY_PROMPT;
+    std::string summary_prompt = prompt::SUMMARY_PROMPT;
     
     // EmbeddingModel config
     std::string embedding_model = "default";
@@ -12,19 +12,22 @@
 #include <functional>
 #include <stdexcept>
 #include <future>
+#include <atomic>
+#include <mutex>
 
 namespace humanus {
 
 class LLM {
 private:
     static std::unordered_map<std::string, std::shared_ptr<LLM>> instances_;
+    static std::mutex instances_mutex_;
 
     std::unique_ptr<httplib::Client> client_;
 
     std::shared_ptr<LLMConfig> llm_config_;
 
-    size_t total_prompt_tokens_;
-    size_t total_completion_tokens_;
+    std::atomic<size_t> total_prompt_tokens_; // Updated concurrently by agents and background memory workers
+    std::atomic<size_t> total_completion_tokens_;
     
 public:
     // Constructor
@@ -40,6 +43,7 @@ public:
 
     // Get the singleton instance
     static std::shared_ptr<LLM> get_instance(const std::string& config_name = "default", const std::shared_ptr<LLMConfig>& llm_config = nullptr) {
+        std::lock_guard<std::mutex> lock(instances_mutex_);
         if (instances_.find(config_name) == instances_.end()) {
             auto llm_config_ = llm_config;
             if (!llm_config_) {
@@ -28,6 +28,7 @@ extern const char* TOOL_HINT_TEMPLATE;
 
 extern const char* FACT_EXTRACTION_PROMPT;
 extern const char* UPDATE_MEMORY_PROMPT;
+extern const char* SUMMARY_PROMPT;
 
 } // namespace prompt
 
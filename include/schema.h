@@ -10,6 +10,8 @@
 #include <vector>
 #include <map>
 #include <algorithm>
+#include <limits>
+#include <optional>
 
 namespace humanus {
 
@@ -173,6 +175,8 @@ struct MemoryItem {
     long long created_at;   // The creation time of the memory, 
     long long updated_at;   // The last update time of the memory
     float score;            // The score associated with the text data, used for ranking and sorting
+    std::string tenant;     // The owner of the memory, empty if not scoped
+    std::vector<std::string> tags; // Free-form labels used for filtering
 
     MemoryItem(size_t id = -1, const std::string& memory = "")
     : id(id), memory(memory) {
@@ -197,6 +201,35 @@ struct MemoryItem {
 
 typedef std::function<bool(const MemoryItem&)> FilterFunc;
 
+// Typed search predicate, all conditions must hold. Unlike `FilterFunc`, vector stores can evaluate it
+// directly against their metadata columns.
+struct MemoryFilter {
+    long long created_after = std::numeric_limits<long long>::min();  // Inclusive time range of `created_at`
+    long long created_before = std::numeric_limits<long long>::max();
+    long long updated_after = std::numeric_limits<long long>::min();  // Inclusive time range of `updated_at`
+    long long updated_before = std::numeric_limits<long long>::max();
+    std::optional<std::string> tenant;  // Only memories of this tenant
+    std::vector<std::string> tags;      // Only memories with at least one of these tags (empty for any)
+
+    bool matches(const MemoryItem& item) const {
+        if (item.created_at < created_after || item.created_at > created_before) {
+            return false;
+        }
+        if (item.updated_at < updated_after || item.updated_at > updated_before) {
+            return false;
+        }
+        if (tenant && item.tenant != *tenant) {
+            return false;
+        }
+        if (!tags.empty()) {
+            return std::any_of(tags.begin(), tags.end(), [&item](const std::string& tag) {
+                return std::find(item.tags.begin(), item.tags.end(), tag) != item.tags.end();
+            });
+        }
+        return true;
+    }
+};
+
 } // namespace humanus
 
 #endif // HUMANUS_SCHEMA_H
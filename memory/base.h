@@ -12,7 +12,12 @@
 #include "utils.h"
 #include "tool/fact_extract.h"
 #include "tool/memory.h"
+#include <condition_variable>
 #include <deque>
+#include <future>
+#include <mutex>
+#include <set>
+#include <thread>
 #include <vector>
 
 namespace humanus {
@@ -21,6 +26,8 @@ struct BaseMemory {
     std::deque<Message> messages;
     std::string current_request;
 
+    virtual ~BaseMemory() = default;
+
     // Add a message to the memory
     virtual bool add_message(const Message& message) {
         messages.push_back(message);
@@ -43,11 +50,17 @@ struct BaseMemory {
     }
 
     virtual std::vector<Message> get_messages(const std::string& query = "") const {
-        std::vector<Message> result;
-        for (const auto& message : messages) {
-            result.push_back(message);
-        }
-        return result;
+        return std::vector<Message>(messages.begin(), messages.end());
+    }
+
+    // Short-term messages without copying (and without retrieval), invalidated by the next modification
+    const std::deque<Message>& messages_view() const {
+        return messages;
+    }
+
+    // Most recent short-term message, nullptr if there is none
+    const Message* last_message() const {
+        return messages.empty() ? nullptr : &messages.back();
     }
 
     // Convert messages to list of dicts
@@ -80,9 +93,38 @@ struct Memory : BaseMemory {
     std::shared_ptr<FactExtract> fact_extract_tool;
     std::shared_ptr<MemoryTool> memory_tool;
 
-    bool retrieval_enabled;
-
-    int num_tokens_messages;
+    std::shared_future<bool> warm_up; // Invalid if the retrieval components could not be created
+
+    // Retrieved memories of the last query, reused until the vector store changes
+    mutable std::mutex retrieval_cache_mutex;
+    mutable std::string retrieval_cache_query;
+    mutable size_t retrieval_cache_version = 0;
+    mutable std::vector<Message> retrieval_cache;
+
+    // Rolling summary of evicted short-term messages (if `config.rolling_summary`), written by the consolidation worker
+    mutable std::mutex summary_mutex;
+    std::string summary;
+    std::shared_ptr<const Message> summary_message;
+    size_t summary_generation = 0; // Bumped by `clear`, so that jobs of a previous run do not resurrect its summary
+
+    int num_tokens_messages = 0;
+
+    // Evicted messages waiting for fact extraction, processed in FIFO order by a single worker
+    struct ConsolidationJob {
+        std::vector<Message> messages;
+        std::string current_request;
+        size_t summary_generation = 0;
+    };
+    std::deque<ConsolidationJob> consolidation_queue;
+    // Evictions not yet handed to the worker, coalesced so that one extraction covers several of them
+    ConsolidationJob pending_consolidation;
+    int pending_consolidation_tokens = 0;
+    std::chrono::steady_clock::time_point pending_consolidation_since;
+    std::mutex consolidation_mutex;
+    std::condition_variable consolidation_cv;
+    bool consolidation_busy = false;
+    bool consolidation_stop = false;
+    std::thread consolidation_worker;
     
     Memory(const MemoryConfig& config) : config(config) {
         fact_extraction_prompt = config.fact_extraction_prompt;
@@ -108,27 +150,22 @@ struct Memory : BaseMemory {
 
         try {
             embedding_model = EmbeddingModel::get_instance(config.embedding_model, config.embedding_model_config);
-            vector_store = VectorStore::get_instance(config.vector_store, config.vector_store_config);
+            vector_store = VectorStore::get_instance(config.vector_store, config.vector_store_config, config.tenant);
             llm = LLM::get_instance(config.llm, config.llm_config);
             llm_vision = LLM::get_instance(config.llm_vision, config.llm_vision_config);
-            
-            logger->info("🔥 Memory is warming up...");
-            auto test_response = llm->ask(
-                {Message::user_message("Hello")}
-            );
-            auto test_embedding = embedding_model->embed(test_response, EmbeddingType::ADD);
-            vector_store->insert(test_embedding, 0);
-            vector_store->remove(0);
-            logger->info("📒 Memory is ready!");
-
-            retrieval_enabled = true;
+
+            if (embedding_model->dim() != vector_store->dim()) { // Every insert and search would be rejected
+                throw std::runtime_error("embedding model " + config.embedding_model + " has " + std::to_string(embedding_model->dim())
+                    + " dimensions, but vector store " + config.vector_store + " has dim " + std::to_string(vector_store->dim()));
+            }
+
+            warm_up = _warm_up(config.llm + "/" + config.embedding_model + "/" + config.vector_store, llm, embedding_model, vector_store);
         } catch (const std::exception& e) {
             logger->warn("Error in initializing memory: " + std::string(e.what()) + ", fallback to default FIFO memory");
             embedding_model = nullptr;
             vector_store = nullptr;
             llm = nullptr;
             llm_vision = nullptr;
-            retrieval_enabled = false;
         }
 
         if (llm_vision && llm_vision->enable_vision() == false) { // Make sure it can handle vision messages
@@ -139,6 +176,64 @@ struct Memory : BaseMemory {
         memory_tool = std::make_shared<MemoryTool>();
     }
 
+    // Check the LLM, embedding model and vector store once per process and combination, in the background.
+    // A failed check is retried by the next Memory that uses the same combination.
+    static std::shared_future<bool> _warm_up(const std::string& key,
+                                             const std::shared_ptr<LLM>& llm,
+                                             const std::shared_ptr<EmbeddingModel>& embedding_model,
+                                             const std::shared_ptr<VectorStore>& vector_store) {
+        static std::mutex warm_ups_mutex;
+        static std::unordered_map<std::string, std::shared_future<bool>> warm_ups;
+
+        std::lock_guard<std::mutex> lock(warm_ups_mutex);
+        auto it = warm_ups.find(key);
+        if (it != warm_ups.end()) {
+            bool failed = it->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready && !it->second.get();
+            if (!failed) {
+                return it->second;
+            }
+        }
+
+        auto future = std::async(std::launch::async, [llm, embedding_model, vector_store]() {
+            try {
+                logger->info("🔥 Memory is warming up...");
+                auto test_response = llm->ask(
+                    {Message::user_message("Hello")}
+                );
+                auto test_embedding = embedding_model->embed(test_response, EmbeddingType::ADD);
+                {
+                    auto lock = vector_store->access_lock();
+                    vector_store->search(test_embedding, 1); // Checks the dimension without writing to (or logging in) the store
+                }
+                logger->info("📒 Memory is ready!");
+                return true;
+            } catch (const std::exception& e) {
+                logger->warn("Error in warming up memory: " + std::string(e.what()) + ", fallback to default FIFO memory");
+                return false;
+            }
+        }).share();
+
+        warm_ups[key] = future;
+        return future;
+    }
+
+    // Blocks until the (shared) warm-up has finished
+    bool retrieval_enabled() const {
+        return warm_up.valid() && warm_up.get();
+    }
+
+    ~Memory() override {
+        flush();
+        {
+            std::lock_guard<std::mutex> lock(consolidation_mutex);
+            consolidation_stop = true;
+        }
+        consolidation_cv.notify_all();
+        if (consolidation_worker.joinable()) {
+            consolidation_worker.join();
+        }
+    }
+
     bool add_message(const Message& message) override {
         if (message.num_tokens > config.max_tokens_message) {
             logger->warn("Message is too long, skipping"); // TODO: use content_provider to handle this
@@ -162,46 +257,38 @@ struct Memory : BaseMemory {
                 messages.pop_front();
             }
         }
-        if (retrieval_enabled && !messages_to_memory.empty()) {
-            if (llm_vision) { // TODO: configure to use multimodal embedding model instead of converting to text
-                for (auto& m : messages_to_memory) {
-                    m = parse_vision_message(m, llm_vision, llm_vision->vision_details());
-                }
-            } else { // Convert to a padding message indicating that the message is a vision message (but not description)
-                for (auto& m : messages_to_memory) {
-                    m = parse_vision_message(m);
-                }
-            }
-            _add_to_vector_store(messages_to_memory); 
+        if (warm_up.valid() && !messages_to_memory.empty()) { // Checked again by the consolidation job
+            _consolidate(std::move(messages_to_memory));
         }
         return true;
     }
 
     std::vector<Message> get_messages(const std::string& query = "") const override {
         std::vector<Message> messages_with_memory;
+        messages_with_memory.reserve(messages.size());
 
-        if (retrieval_enabled && !query.empty()) {
-            auto embeddings = embedding_model->embed(
-                query,
-                EmbeddingType::SEARCH
-            );
-            std::vector<MemoryItem> memories;
-            
-            // Check if vectore store is available
-            if (vector_store) {
-                memories = vector_store->search(embeddings, retrieval_limit, filter);
-            }
+        std::shared_ptr<const Message> summary;
+        if (config.rolling_summary) {
+            std::lock_guard<std::mutex> lock(summary_mutex);
+            summary = summary_message;
+        }
 
-            if (!memories.empty()) {
-                sort(memories.begin(), memories.end(), [](const MemoryItem& a, const MemoryItem& b) {
-                    return a.updated_at > b.updated_at;
-                });
+        if (!query.empty() && retrieval_enabled() && vector_store) {
+            // Facts of already evicted messages must be retrievable, don't leave them in the window or the queue.
+            // The memory itself is never const, `flush` only touches the (synchronized) consolidation state.
+            const_cast<Memory*>(this)->flush();
+
+            std::lock_guard<std::mutex> lock(retrieval_cache_mutex);
+
+            if (retrieval_cache_query != query || retrieval_cache_version != vector_store->version()) {
+                _refresh_retrieval_cache(query);
+            }
 
-                int num_tokens_context = num_tokens_messages;
+            if (!retrieval_cache.empty()) {
+                int num_tokens_context = num_tokens_messages + (summary ? summary->num_tokens : 0);
                 std::deque<Message> memory_messages;
 
-                for (const auto& memory_item : memories) { // Make sure the oldest memory is at the front of the deque and the tokens within the limit
-                    auto memory_message = Message::user_message("<memory>" + memory_item.memory + "</memory>");
+                for (const auto& memory_message : retrieval_cache) { // Make sure the oldest memory is at the front of the deque and the tokens within the limit
                     if (num_tokens_context + memory_message.num_tokens > config.max_tokens_context) {
                         break;
                     }
@@ -211,33 +298,204 @@ struct Memory : BaseMemory {
 
                 logger->info("📤 Total retreived memories: " + std::to_string(memory_messages.size()));
 
-                messages_with_memory.insert(messages_with_memory.end(), memory_messages.begin(), memory_messages.end());
+                messages_with_memory.reserve(memory_messages.size() + messages.size());
+                messages_with_memory.insert(messages_with_memory.end(), std::make_move_iterator(memory_messages.begin()), std::make_move_iterator(memory_messages.end()));
             }
         }
 
+        if (summary) {
+            messages_with_memory.push_back(*summary);
+        }
+
         messages_with_memory.insert(messages_with_memory.end(), messages.begin(), messages.end());
 
         return messages_with_memory;
     }
 
+    // Embed the query and rebuild the `<memory>` messages, most recently updated first. Requires `retrieval_cache_mutex`.
+    void _refresh_retrieval_cache(const std::string& query) const {
+        retrieval_cache.clear();
+        retrieval_cache_query.clear();
+
+        auto version = vector_store->version(); // Read before searching so that concurrent writes invalidate the result
+        auto embeddings = embedding_model->embed(
+            query,
+            EmbeddingType::SEARCH
+        );
+        std::vector<MemoryItem> memories;
+        {
+            auto lock = vector_store->access_lock();
+            memories = vector_store->search(embeddings, retrieval_limit, filter);
+        }
+
+        sort(memories.begin(), memories.end(), [](const MemoryItem& a, const MemoryItem& b) {
+            return a.updated_at > b.updated_at;
+        });
+
+        retrieval_cache.reserve(memories.size());
+        for (const auto& memory_item : memories) {
+            retrieval_cache.push_back(Message::user_message("<memory>" + memory_item.memory + "</memory>"));
+        }
+        retrieval_cache_query = query;
+        retrieval_cache_version = version;
+    }
+
     void clear() override {
         if (messages.empty()) {
             return;
         }
-        if (retrieval_enabled) {
-            std::vector<Message> messages_to_memory(messages.begin(), messages.end());
-            _add_to_vector_store(messages_to_memory);
+        if (warm_up.valid()) {
+            _consolidate(std::vector<Message>(messages.begin(), messages.end()), true);
         }
         messages.clear();
+        num_tokens_messages = 0;
+
+        std::lock_guard<std::mutex> lock(summary_mutex);
+        summary.clear();
+        summary_message = nullptr;
+        summary_generation++;
     }
 
-    void _add_to_vector_store(const std::vector<Message>& messages) {
-        // Check if vector store is available
-        if (!vector_store) {
-            logger->warn("Vector store is not initialized, skipping memory operation");
+    size_t _summary_generation() const {
+        std::lock_guard<std::mutex> lock(summary_mutex);
+        return summary_generation;
+    }
+
+    // Block until all evicted messages (including a partially filled batch) have been written to the vector store
+    void flush() {
+        std::unique_lock<std::mutex> lock(consolidation_mutex);
+        _submit_pending_consolidation(lock);
+        consolidation_cv.wait(lock, [this] {
+            return consolidation_queue.empty() && !consolidation_busy;
+        });
+    }
+
+    // Add evicted messages to the pending batch and submit it once a count/token/time threshold is reached
+    void _consolidate(std::vector<Message> messages_to_memory, bool force = false) {
+        std::unique_lock<std::mutex> lock(consolidation_mutex);
+
+        if (!pending_consolidation.messages.empty() && pending_consolidation.current_request != current_request) {
+            _submit_pending_consolidation(lock); // Facts are extracted in the context of a single request
+        }
+
+        if (pending_consolidation.messages.empty()) {
+            pending_consolidation.current_request = current_request;
+            pending_consolidation.summary_generation = _summary_generation();
+            pending_consolidation_since = std::chrono::steady_clock::now();
+        }
+        for (auto& message : messages_to_memory) {
+            pending_consolidation_tokens += message.num_tokens;
+            pending_consolidation.messages.push_back(std::move(message));
+        }
+
+        if (force || _pending_consolidation_ready()) {
+            _submit_pending_consolidation(lock);
+        } else if (config.async_consolidation && config.consolidation_window_ms > 0) {
+            if (!consolidation_worker.joinable()) {
+                consolidation_worker = std::thread(&Memory::_consolidation_loop, this);
+            }
+            consolidation_cv.notify_all(); // Let the worker time the window
+        }
+    }
+
+    bool _pending_consolidation_ready() const {
+        if (static_cast<int>(pending_consolidation.messages.size()) >= config.consolidation_batch_messages) {
+            return true;
+        }
+        if (config.consolidation_batch_tokens > 0 && pending_consolidation_tokens >= config.consolidation_batch_tokens) {
+            return true;
+        }
+        return config.consolidation_window_ms > 0
+            && std::chrono::steady_clock::now() - pending_consolidation_since >= std::chrono::milliseconds(config.consolidation_window_ms);
+    }
+
+    // Hand the pending batch over to the worker (or process it inline if async consolidation is disabled), `lock` must hold `consolidation_mutex`
+    void _submit_pending_consolidation(std::unique_lock<std::mutex>& lock) {
+        if (pending_consolidation.messages.empty()) {
             return;
         }
-        
+
+        ConsolidationJob job = std::move(pending_consolidation);
+        pending_consolidation = ConsolidationJob();
+        pending_consolidation_tokens = 0;
+
+        if (!config.async_consolidation) {
+            lock.unlock();
+            _process_consolidation_job(job);
+            lock.lock();
+            return;
+        }
+
+        // Backpressure: do not let the agent run arbitrarily far ahead of consolidation
+        consolidation_cv.wait(lock, [this] {
+            return consolidation_queue.size() < static_cast<size_t>(config.max_pending_consolidations);
+        });
+        consolidation_queue.push_back(std::move(job));
+        if (!consolidation_worker.joinable()) {
+            consolidation_worker = std::thread(&Memory::_consolidation_loop, this);
+        }
+        consolidation_cv.notify_all();
+    }
+
+    void _consolidation_loop() {
+        std::unique_lock<std::mutex> lock(consolidation_mutex);
+        while (true) {
+            if (consolidation_queue.empty()) {
+                if (consolidation_stop) { // Only stops after the queue is drained
+                    return;
+                }
+                if (!pending_consolidation.messages.empty() && config.consolidation_window_ms > 0) {
+                    auto deadline = pending_consolidation_since + std::chrono::milliseconds(config.consolidation_window_ms);
+                    if (std::chrono::steady_clock::now() < deadline) {
+                        consolidation_cv.wait_until(lock, deadline);
+                        continue;
+                    }
+                    consolidation_queue.push_back(std::move(pending_consolidation)); // Window closed
+                    pending_consolidation = ConsolidationJob();
+                    pending_consolidation_tokens = 0;
+                } else {
+                    consolidation_cv.wait(lock);
+                    continue;
+                }
+            }
+            auto job = std::move(consolidation_queue.front());
+            consolidation_queue.pop_front();
+            consolidation_busy = true;
+            lock.unlock();
+            consolidation_cv.notify_all(); // Wake up producers blocked on backpressure
+
+            _process_consolidation_job(job);
+
+            lock.lock();
+            consolidation_busy = false;
+            consolidation_cv.notify_all(); // Wake up `flush`
+        }
+    }
+
+    void _process_consolidation_job(ConsolidationJob& job) {
+        if (!retrieval_enabled()) {
+            return;
+        }
+        try {
+            if (llm_vision) { // TODO: configure to use multimodal embedding model instead of converting to text
+                for (auto& m : job.messages) {
+                    m = parse_vision_message(m, llm_vision, llm_vision->vision_details());
+                }
+            } else { // Convert to a padding message indicating that the message is a vision message (but not description)
+                for (auto& m : job.messages) {
+                    m = parse_vision_message(m);
+                }
+            }
+            if (config.rolling_summary && job.summary_generation == _summary_generation()) {
+                _update_summary(job);
+            }
+            _add_to_vector_store(job.messages, job.current_request);
+        } catch (const std::exception& e) {
+            logger->error("Error in memory consolidation: " + std::string(e.what()));
+        }
+    }
+
+    static std::string _format_messages(const std::vector<Message>& messages) {
         std::string parsed_message;
         
         for (const auto& message : messages) {
@@ -247,6 +505,57 @@ struct Memory : BaseMemory {
                 parsed_message += "<tool_call>" + tool_call.to_json().dump() + "</tool_call>\n";
             }
         }
+
+        return parsed_message;
+    }
+
+    // Fold the evicted messages of `job` into the rolling summary
+    void _update_summary(const ConsolidationJob& job) {
+        std::string previous_summary;
+        {
+            std::lock_guard<std::mutex> lock(summary_mutex);
+            previous_summary = summary;
+        }
+
+        std::string system_prompt = config.summary_prompt;
+        size_t pos = system_prompt.find("{current_request}");
+        if (pos != std::string::npos) {
+            system_prompt.replace(pos, 17, job.current_request);
+        }
+        pos = system_prompt.find("{max_tokens}");
+        if (pos != std::string::npos) {
+            system_prompt.replace(pos, 12, std::to_string(config.max_tokens_summary));
+        }
+
+        std::string new_summary = llm->ask(
+            {Message::user_message("<summary>" + previous_summary + "</summary>\n<input>" + _format_messages(job.messages) + "</input>")},
+            system_prompt
+        );
+
+        auto tokens = Message::tokenizer->encode(new_summary);
+        if (static_cast<int>(tokens.size()) > config.max_tokens_summary) { // Keep the prompt bounded even if the model ignores the limit
+            tokens.resize(config.max_tokens_summary);
+            new_summary = Message::tokenizer->decode(tokens);
+        }
+
+        auto new_summary_message = std::make_shared<const Message>(Message::user_message("<summary>" + new_summary + "</summary>"));
+
+        std::lock_guard<std::mutex> lock(summary_mutex);
+        if (job.summary_generation == summary_generation) {
+            summary = std::move(new_summary);
+            summary_message = new_summary_message;
+            logger->info("📝 Summary of evicted messages updated: " + std::to_string(new_summary_message->num_tokens) + " tokens");
+        }
+    }
+
+    void _add_to_vector_store(const std::vector<Message>& messages, const std::string& current_request) {
+        // Check if vector store is available
+        if (!vector_store) {
+            logger->warn("Vector store is not initialized, skipping memory operation");
+            return;
+        }
+        
+        std::string parsed_message = _format_messages(messages);
     
         std::string system_prompt = fact_extraction_prompt;
 
@@ -291,6 +600,23 @@ struct Memory : BaseMemory {
             logger->warn("Error in new_facts: " + std::string(e.what()));
         }
 
+        // Drop facts repeated within this batch or already remembered verbatim
+        std::set<std::string> fact_hashes;
+        {
+            auto lock = vector_store->access_lock();
+            new_facts.erase(std::remove_if(new_facts.begin(), new_facts.end(), [&](const std::string& fact) {
+                auto hash = httplib::detail::MD5(fact);
+                if (!fact_hashes.insert(hash).second) {
+                    return true;
+                }
+                if (vector_store->contains_hash(hash)) {
+                    logger->debug("Skipping duplicate fact: " + fact);
+                    return true;
+                }
+                return false;
+            }), new_facts.end());
+        }
+
         if (new_facts.empty()) {
             return;
         }
@@ -299,21 +625,39 @@ struct Memory : BaseMemory {
 
         std::vector<json> old_memories;
         std::map<std::string, std::vector<float>> new_message_embeddings;
+        std::vector<std::string> facts_to_remember;
+
+        auto fact_embeddings = embedding_model->embed_batch(new_facts, EmbeddingType::ADD);
+        std::vector<std::vector<MemoryItem>> fact_neighbors;
+        {
+            auto lock = vector_store->access_lock();
+            fact_neighbors = vector_store->search_batch(fact_embeddings, 5);
+        }
 
-        for (const auto& fact : new_facts) {
-            auto message_embedding = embedding_model->embed(fact, EmbeddingType::ADD);
-            new_message_embeddings[fact] = message_embedding;
-            auto existing_memories = vector_store->search(
-                message_embedding,
-                5
-            );
+        for (size_t i = 0; i < new_facts.size(); ++i) {
+            const auto& message_embedding = fact_embeddings[i];
+            const auto& existing_memories = fact_neighbors[i];
+            facts_to_remember.push_back(new_facts[i]);
+            new_message_embeddings[new_facts[i]] = message_embedding;
             for (const auto& memory : existing_memories) {
+                if (config.update_distance_threshold >= 0 && memory.score > config.update_distance_threshold) {
+                    continue; // Too far away to conflict with the new fact
+                }
                 old_memories.push_back({
                     {"id", memory.id},
                     {"text", memory.memory}
                 });
             }
         }
+
+        if (facts_to_remember.empty()) {
+            return;
+        }
+
+        if (old_memories.empty()) { // Nothing to update or delete, so every fact becomes an ADD event
+            _create_memories(facts_to_remember, new_message_embeddings);
+            return;
+        }
         // sort and unique by id
         std::sort(old_memories.begin(), old_memories.end(), [](const json& a, const json& b) {
             return a["id"] < b["id"];
@@ -330,7 +674,7 @@ struct Memory : BaseMemory {
             old_memories[idx]["id"] = idx;
         }
 
-        std::string function_calling_prompt = get_update_memory_messages(old_memories, new_facts, update_memory_prompt);
+        std::string function_calling_prompt = get_update_memory_messages(old_memories, facts_to_remember, update_memory_prompt);
 
         // std::string new_memories_with_actions_str;
         // json new_memories_with_actions = json::array();
@@ -382,6 +726,8 @@ struct Memory : BaseMemory {
             logger->warn("Error in memory_events: " + std::string(e.what()));
         }
 
+        std::vector<std::string> added_memories; // Inserted together after the other events
+
         try {
             for (const auto& event : memory_events) {
                 logger->debug("Processing memory: " + event.dump(2));
@@ -402,11 +748,7 @@ struct Memory : BaseMemory {
                         memory_id = get_uuid_64();
                     }
                     if (type == "ADD") {
-                        _create_memory(
-                            memory_id,
-                            event["text"], // data
-                            new_message_embeddings // existing_embeddings
-                        );
+                        added_memories.push_back(event["text"]);
                     } else if (type == "UPDATE") {
                         _update_memory(
                             memory_id,
@@ -423,33 +765,51 @@ struct Memory : BaseMemory {
         } catch (const std::exception& e) {
             logger->error("Error in new_memories_with_actions: " + std::string(e.what()));
         }
+
+        try {
+            _create_memories(added_memories, new_message_embeddings);
+        } catch (const std::exception& e) {
+            logger->error("Error in new_memories_with_actions: " + std::string(e.what()));
+        }
     }
 
-    void _create_memory(const size_t& memory_id, const std::string& data, const std::map<std::string, std::vector<float>>& existing_embeddings) {
+    // Embeds what is not in `existing_embeddings` in one batch and inserts all memories at once
+    void _create_memories(const std::vector<std::string>& data, const std::map<std::string, std::vector<float>>& existing_embeddings) {
         if (!vector_store) {
             logger->warn("Vector store is not initialized, skipping create memory");
             return;
         }
+        if (data.empty()) {
+            return;
+        }
 
-        logger->info("🆕 Creating memory: " + data);
-        
-        std::vector<float> embedding;
-        if (existing_embeddings.find(data) != existing_embeddings.end()) {
-            embedding = existing_embeddings.at(data);
-        } else {
-            embedding = embedding_model->embed(data, EmbeddingType::ADD);
+        std::vector<std::vector<float>> embeddings(data.size());
+        std::vector<size_t> memory_ids;
+        std::vector<MemoryItem> metadatas;
+        std::vector<std::string> missing_data;
+        std::vector<size_t> missing_index;
+        for (size_t i = 0; i < data.size(); ++i) {
+            logger->info("🆕 Creating memory: " + data[i]);
+            auto it = existing_embeddings.find(data[i]);
+            if (it != existing_embeddings.end()) {
+                embeddings[i] = it->second;
+            } else {
+                missing_data.push_back(data[i]);
+                missing_index.push_back(i);
+            }
+            memory_ids.push_back(get_uuid_64());
+            metadatas.emplace_back(memory_ids.back(), data[i]);
         }
 
-        MemoryItem metadata{
-            memory_id,
-            data
-        };
+        if (!missing_data.empty()) {
+            auto missing_embeddings = embedding_model->embed_batch(missing_data, EmbeddingType::ADD);
+            for (size_t i = 0; i < missing_index.size(); ++i) {
+                embeddings[missing_index[i]] = std::move(missing_embeddings.at(i));
+            }
+        }
 
-        vector_store->insert(
-            embedding,
-            memory_id,
-            metadata
-        );
+        auto lock = vector_store->access_lock();
+        vector_store->insert_batch(embeddings, memory_ids, metadatas);
     }
 
     void _update_memory(const size_t& memory_id, const std::string& data, const std::map<std::string, std::vector<float>>& existing_embeddings) {
@@ -461,6 +821,7 @@ struct Memory : BaseMemory {
         MemoryItem existing_memory;
 
         try {
+            auto lock = vector_store->access_lock();
             existing_memory = vector_store->get(memory_id);
         } catch (const std::exception& e) {
             logger->error("Error fetching existing memory: " + std::string(e.what()));
@@ -478,6 +839,7 @@ struct Memory : BaseMemory {
 
         existing_memory.update_memory(data);
 
+        auto lock = vector_store->access_lock();
         vector_store->update(
             memory_id,
             embedding,
@@ -492,6 +854,7 @@ struct Memory : BaseMemory {
         }
         
         logger->info("❌ Deleting memory: " + std::to_string(memory_id));
+        auto lock = vector_store->access_lock();
         vector_store->remove(memory_id);
     }
 };
@@ -1,11 +1,16 @@
 #include "base.h"
 #include "oai.h"
+#include "local.h"
+#include "batched.h"
+#include "cached.h"
 
 namespace humanus {
 
 std::unordered_map<std::string, std::shared_ptr<EmbeddingModel>> EmbeddingModel::instances_;
+std::mutex EmbeddingModel::instances_mutex_;
 
 std::shared_ptr<EmbeddingModel> EmbeddingModel::get_instance(const std::string& config_name, const std::shared_ptr<EmbeddingModelConfig>& config)  {
+    std::lock_guard<std::mutex> lock(instances_mutex_);
     if (instances_.find(config_name) == instances_.end()) {
         auto config_ = config;
         if (!config_) {
@@ -14,9 +19,19 @@ std::shared_ptr<EmbeddingModel> EmbeddingModel::get_instance(const std::string&
 
         if (config_->provider == "oai") {
             instances_[config_name] = std::make_shared<OAIEmbeddingModel>(config_);
+        } else if (config_->provider == "local") {
+            instances_[config_name] = std::make_shared<LocalEmbeddingModel>(config_);
         } else {
             throw std::invalid_argument("Unsupported embedding model provider: " + config_->provider);
         }
+
+        if (config_->batch_window_ms > 0) { // Share batches across all callers of this instance
+            instances_[config_name] = std::make_shared<BatchedEmbeddingModel>(config_, instances_[config_name]);
+        }
+
+        if (config_->cache_size > 0 || !config_->cache_path.empty()) { // Cache hits skip the batching window as well
+            instances_[config_name] = std::make_shared<CachedEmbeddingModel>(config_, instances_[config_name]);
+        }
     }
     return instances_[config_name];
 }
@@ -6,12 +6,14 @@
 #include <vector>
 #include <unordered_map>
 #include <memory>
+#include <mutex>
 
 namespace humanus {
 
 class EmbeddingModel {
 private:
     static std::unordered_map<std::string, std::shared_ptr<EmbeddingModel>> instances_;
+    static std::mutex instances_mutex_;
 
 protected:
     std::shared_ptr<EmbeddingModelConfig> config_;
@@ -25,7 +27,26 @@ public:
 
     virtual ~EmbeddingModel() = default;
 
+    int dim() const {
+        return config_->embedding_dims;
+    }
+
     virtual std::vector<float> embed(const std::string& text, EmbeddingType type) = 0;
+
+    /**
+     * @brief Embed multiple texts, results are in the same order as `texts`
+     * @param texts texts to embed
+     * @param type embedding type
+     * @return list of embeddings
+     */
+    virtual std::vector<std::vector<float>> embed_batch(const std::vector<std::string>& texts, EmbeddingType type) {
+        std::vector<std::vector<float>> embeddings;
+        embeddings.reserve(texts.size());
+        for (const auto& text : texts) {
+            embeddings.push_back(embed(text, type));
+        }
+        return embeddings;
+    }
 };
 
 } // namespace humanus
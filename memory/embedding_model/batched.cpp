@@ -0,0 +1,94 @@
+#include "batched.h"
+
+namespace humanus {
+
+BatchedEmbeddingModel::~BatchedEmbeddingModel() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+std::future<std::vector<float>> BatchedEmbeddingModel::_enqueue(const std::string& text, EmbeddingType type) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back({text, type, std::promise<std::vector<float>>(), std::chrono::steady_clock::now()});
+    auto future = queue_.back().promise.get_future();
+    cv_.notify_one();
+    return future;
+}
+
+std::vector<float> BatchedEmbeddingModel::embed(const std::string& text, EmbeddingType type) {
+    return _enqueue(text, type).get();
+}
+
+std::vector<std::vector<float>> BatchedEmbeddingModel::embed_batch(const std::vector<std::string>& texts, EmbeddingType type) {
+    std::vector<std::future<std::vector<float>>> futures;
+    futures.reserve(texts.size());
+    for (const auto& text : texts) {
+        futures.push_back(_enqueue(text, type));
+    }
+
+    std::vector<std::vector<float>> embeddings;
+    embeddings.reserve(texts.size());
+    for (auto& future : futures) {
+        embeddings.push_back(future.get());
+    }
+    return embeddings;
+}
+
+void BatchedEmbeddingModel::_run() {
+    const auto window = std::chrono::milliseconds(config_->batch_window_ms);
+    const size_t max_batch_size = std::max(config_->max_batch_size, 1);
+
+    while (true) {
+        std::vector<Request> batch;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (queue_.empty()) { // stop_ and nothing left to serve
+                return;
+            }
+
+            // Wait for more requests until the window of the oldest one closes or the batch is full
+            auto deadline = queue_.front().enqueued_at + window;
+            cv_.wait_until(lock, deadline, [this, max_batch_size] { return stop_ || queue_.size() >= max_batch_size; });
+
+            // Take requests of the same type as the oldest one, keeping the order of the others
+            EmbeddingType type = queue_.front().type;
+            for (auto it = queue_.begin(); it != queue_.end() && batch.size() < max_batch_size;) {
+                if (it->type == type) {
+                    batch.push_back(std::move(*it));
+                    it = queue_.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        std::vector<std::string> texts;
+        texts.reserve(batch.size());
+        for (const auto& request : batch) {
+            texts.push_back(request.text);
+        }
+
+        try {
+            auto embeddings = model_->embed_batch(texts, batch.front().type);
+            if (embeddings.size() != batch.size()) {
+                throw std::runtime_error("Expected " + std::to_string(batch.size()) + " embeddings, got " + std::to_string(embeddings.size()));
+            }
+            for (size_t i = 0; i < batch.size(); ++i) {
+                batch[i].promise.set_value(std::move(embeddings[i]));
+            }
+        } catch (...) {
+            for (auto& request : batch) {
+                request.promise.set_exception(std::current_exception());
+            }
+        }
+    }
+}
+
+} // namespace humanus
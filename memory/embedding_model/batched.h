@@ -0,0 +1,51 @@
+#ifndef HUMANUS_MEMORY_EMBEDDING_MODEL_BATCHED_H
+#define HUMANUS_MEMORY_EMBEDDING_MODEL_BATCHED_H
+
+#include "base.h"
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <thread>
+
+namespace humanus {
+
+// Collects embedding requests from all callers for up to `batch_window_ms` or `max_batch_size` texts,
+// sends them to the wrapped model as one batch and fans the results back out through futures.
+class BatchedEmbeddingModel : public EmbeddingModel {
+private:
+    struct Request {
+        std::string text;
+        EmbeddingType type;
+        std::promise<std::vector<float>> promise;
+        std::chrono::steady_clock::time_point enqueued_at;
+    };
+
+    std::shared_ptr<EmbeddingModel> model_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::deque<Request> queue_;
+    bool stop_ = false;
+    std::thread worker_;
+
+    std::future<std::vector<float>> _enqueue(const std::string& text, EmbeddingType type);
+
+    void _run();
+
+public:
+    BatchedEmbeddingModel(const std::shared_ptr<EmbeddingModelConfig>& config, const std::shared_ptr<EmbeddingModel>& model)
+        : EmbeddingModel(config), model_(model) {
+        worker_ = std::thread(&BatchedEmbeddingModel::_run, this);
+    }
+
+    ~BatchedEmbeddingModel() override;
+
+    std::vector<float> embed(const std::string& text, EmbeddingType type) override;
+
+    std::vector<std::vector<float>> embed_batch(const std::vector<std::string>& texts, EmbeddingType type) override;
+};
+
+} // namespace humanus
+
+#endif // HUMANUS_MEMORY_EMBEDDING_MODEL_BATCHED_H
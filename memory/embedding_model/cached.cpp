@@ -0,0 +1,234 @@
+#include "cached.h"
+#include <algorithm>
+
+namespace humanus {
+
+// Record layout in the cache file: 32-byte hex MD5 key, uint32 dimension, float32[dimension]
+static constexpr size_t CACHE_KEY_SIZE = 32;
+
+std::string CachedEmbeddingModel::_model_id() const {
+    if (config_->provider != "local") {
+        return config_->model;
+    }
+    // The local provider ignores `model`, so switching (or replacing) the GGUF file must change the key
+    std::string id = config_->model_path;
+    std::error_code ec;
+    auto size = std::filesystem::file_size(config_->model_path, ec);
+    if (!ec) {
+        id += '\0' + std::to_string(size);
+    }
+    auto mtime = std::filesystem::last_write_time(config_->model_path, ec);
+    if (!ec) {
+        id += '\0' + std::to_string(mtime.time_since_epoch().count());
+    }
+    return id;
+}
+
+std::string CachedEmbeddingModel::_key(const std::string& text, EmbeddingType type) const {
+    return httplib::detail::MD5(model_id_ + '\0' + std::to_string(static_cast<int>(type)) + '\0' + text);
+}
+
+void CachedEmbeddingModel::_load_file() {
+    auto path = std::filesystem::path(config_->cache_path);
+    if (path.has_parent_path()) {
+        std::filesystem::create_directories(path.parent_path());
+    }
+    if (!std::filesystem::exists(path)) {
+        std::ofstream(path, std::ios::binary).close();
+    }
+
+    file_.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file_.is_open()) {
+        logger->warn("Failed to open embedding cache file: " + path.string());
+        return;
+    }
+
+    // Build the index, truncated records at the tail (e.g. after a crash) are ignored and overwritten
+    auto file_size = static_cast<std::streamoff>(std::filesystem::file_size(path));
+    std::streamoff offset = 0;
+    std::string key(CACHE_KEY_SIZE, '\0');
+    uint32_t dim;
+    while (file_.read(key.data(), CACHE_KEY_SIZE) && file_.read(reinterpret_cast<char*>(&dim), sizeof(dim))) {
+        std::streamoff next = offset + CACHE_KEY_SIZE + sizeof(dim) + static_cast<std::streamoff>(dim) * sizeof(float);
+        if (next > file_size || !file_.seekg(next)) {
+            break;
+        }
+        file_index_[key] = {offset, ++file_clock_}; // Records are appended (and compacted) oldest first
+        offset = next;
+    }
+    file_.clear();
+    file_.seekp(offset);
+
+    logger->info("Loaded " + std::to_string(file_index_.size()) + " cached embeddings from " + path.string());
+
+    if (config_->cache_file_size > 0 && file_index_.size() > static_cast<size_t>(config_->cache_file_size)) {
+        _compact_file();
+    }
+}
+
+bool CachedEmbeddingModel::_read_record(std::streamoff offset, std::vector<float>& embedding) {
+    uint32_t dim;
+    auto put_pos = file_.tellp();
+    file_.seekg(offset + CACHE_KEY_SIZE);
+    file_.read(reinterpret_cast<char*>(&dim), sizeof(dim));
+    embedding.resize(dim);
+    file_.read(reinterpret_cast<char*>(embedding.data()), static_cast<std::streamsize>(dim) * sizeof(float));
+    bool ok = static_cast<bool>(file_);
+    file_.clear();
+    file_.seekp(put_pos);
+    return ok;
+}
+
+void CachedEmbeddingModel::_compact_file() {
+    std::vector<std::pair<uint64_t, std::string>> entries; // (last used, key)
+    entries.reserve(file_index_.size());
+    for (const auto& [key, entry] : file_index_) {
+        entries.emplace_back(entry.last_used, key);
+    }
+    std::sort(entries.begin(), entries.end());
+    entries.erase(entries.begin(), entries.end() - std::min<size_t>(entries.size(), config_->cache_file_size / 2));
+
+    auto path = std::filesystem::path(config_->cache_path);
+    auto tmp_path = path;
+    tmp_path += ".tmp";
+    std::unordered_map<std::string, FileEntry> index;
+    {
+        std::ofstream out(tmp_path, std::ios::binary | std::ios::trunc);
+        std::vector<float> embedding;
+        std::streamoff offset = 0;
+        for (const auto& [last_used, key] : entries) {
+            if (!_read_record(file_index_[key].offset, embedding)) {
+                continue;
+            }
+            uint32_t dim = embedding.size();
+            out.write(key.data(), CACHE_KEY_SIZE);
+            out.write(reinterpret_cast<const char*>(&dim), sizeof(dim));
+            out.write(reinterpret_cast<const char*>(embedding.data()), static_cast<std::streamsize>(dim) * sizeof(float));
+            index[key] = {offset, last_used};
+            offset += CACHE_KEY_SIZE + sizeof(dim) + static_cast<std::streamoff>(dim) * sizeof(float);
+        }
+        out.flush();
+        if (!out) {
+            logger->warn("Failed to compact embedding cache file: " + path.string());
+            std::filesystem::remove(tmp_path);
+            return;
+        }
+    }
+
+    file_.close();
+    std::filesystem::rename(tmp_path, path);
+    file_.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file_.is_open()) {
+        logger->warn("Failed to open embedding cache file: " + path.string());
+        file_index_.clear();
+        return;
+    }
+    file_.seekp(0, std::ios::end);
+
+    logger->info("Compacted " + path.string() + " from " + std::to_string(file_index_.size()) + " to " + std::to_string(index.size()) + " cached embeddings");
+    file_index_ = std::move(index);
+}
+
+bool CachedEmbeddingModel::_get(const std::string& key, std::vector<float>& embedding) {
+    auto it = lru_map_.find(key);
+    if (it != lru_map_.end()) {
+        lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
+        embedding = it->second->second;
+        return true;
+    }
+
+    auto file_it = file_index_.find(key);
+    if (file_it == file_index_.end() || !_read_record(file_it->second.offset, embedding)) {
+        return false;
+    }
+
+    file_it->second.last_used = ++file_clock_;
+    _put(key, embedding);
+    return true;
+}
+
+void CachedEmbeddingModel::_put(const std::string& key, const std::vector<float>& embedding) {
+    auto it = lru_map_.find(key);
+    if (it != lru_map_.end()) {
+        lru_list_.splice(lru_list_.begin(), lru_list_, it->second);
+    } else if (config_->cache_size > 0) {
+        if (lru_map_.size() >= static_cast<size_t>(config_->cache_size)) {
+            lru_map_.erase(lru_list_.back().first);
+            lru_list_.pop_back();
+        }
+        lru_list_.emplace_front(key, embedding);
+        lru_map_[key] = lru_list_.begin();
+    }
+
+    if (file_.is_open() && file_index_.find(key) == file_index_.end()) {
+        auto offset = file_.tellp();
+        uint32_t dim = embedding.size();
+        file_.write(key.data(), CACHE_KEY_SIZE);
+        file_.write(reinterpret_cast<const char*>(&dim), sizeof(dim));
+        file_.write(reinterpret_cast<const char*>(embedding.data()), static_cast<std::streamsize>(dim) * sizeof(float));
+        file_.flush();
+        if (file_) {
+            file_index_[key] = {offset, ++file_clock_};
+            if (config_->cache_file_size > 0 && file_index_.size() > static_cast<size_t>(config_->cache_file_size)) {
+                _compact_file();
+            }
+        } else {
+            logger->warn("Failed to write embedding cache file: " + config_->cache_path);
+            file_.close();
+        }
+    }
+}
+
+std::vector<float> CachedEmbeddingModel::embed(const std::string& text, EmbeddingType type) {
+    auto key = _key(text, type);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<float> embedding;
+        if (_get(key, embedding)) {
+            return embedding;
+        }
+    }
+
+    auto embedding = model_->embed(text, type); // Don't hold the lock during the request
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    _put(key, embedding);
+    return embedding;
+}
+
+std::vector<std::vector<float>> CachedEmbeddingModel::embed_batch(const std::vector<std::string>& texts, EmbeddingType type) {
+    std::vector<std::vector<float>> embeddings(texts.size());
+    std::vector<std::string> keys;
+    keys.reserve(texts.size());
+
+    std::vector<std::string> missing_texts;
+    std::unordered_map<std::string, size_t> missing_index; // key -> index in missing_texts, also dedupes repeated texts
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < texts.size(); ++i) {
+            keys.push_back(_key(texts[i], type));
+            if (!_get(keys[i], embeddings[i]) && missing_index.find(keys[i]) == missing_index.end()) {
+                missing_index[keys[i]] = missing_texts.size();
+                missing_texts.push_back(texts[i]);
+            }
+        }
+    }
+
+    if (missing_texts.empty()) {
+        return embeddings;
+    }
+
+    auto missing_embeddings = model_->embed_batch(missing_texts, type);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < texts.size(); ++i) {
+        auto it = missing_index.find(keys[i]);
+        if (it != missing_index.end()) {
+            embeddings[i] = missing_embeddings.at(it->second);
+            _put(keys[i], embeddings[i]);
+        }
+    }
+    return embeddings;
+}
+
+} // namespace humanus
@@ -0,0 +1,67 @@
+#ifndef HUMANUS_MEMORY_EMBEDDING_MODEL_CACHED_H
+#define HUMANUS_MEMORY_EMBEDDING_MODEL_CACHED_H
+
+#include "base.h"
+#include <fstream>
+#include <list>
+#include <mutex>
+
+namespace humanus {
+
+// Bounded LRU cache in front of another embedding model, keyed by model (name, or weights file of the local
+// provider), EmbeddingType and text hash. If `cache_path` is set, embeddings are also appended to that file and
+// looked up there on LRU misses. Beyond `cache_file_size` entries the file is rewritten with the most recently
+// used half.
+class CachedEmbeddingModel : public EmbeddingModel {
+private:
+    std::shared_ptr<EmbeddingModel> model_;
+
+    std::mutex mutex_;
+    std::list<std::pair<std::string, std::vector<float>>> lru_list_;
+    std::unordered_map<std::string, std::list<std::pair<std::string, std::vector<float>>>::iterator> lru_map_;
+
+    // Persistent tier: key -> offset of the record in `cache_path` and when it was last used
+    struct FileEntry {
+        std::streamoff offset;
+        uint64_t last_used;
+    };
+    std::fstream file_;
+    std::unordered_map<std::string, FileEntry> file_index_;
+    uint64_t file_clock_ = 0;
+
+    std::string model_id_;
+
+    std::string _model_id() const;
+
+    std::string _key(const std::string& text, EmbeddingType type) const;
+
+    // Look up the LRU and then the file, requires `mutex_`
+    bool _get(const std::string& key, std::vector<float>& embedding);
+
+    // Insert into the LRU (and the file if not yet stored), requires `mutex_`
+    void _put(const std::string& key, const std::vector<float>& embedding);
+
+    void _load_file();
+
+    // Read the embedding of the record at `offset`, requires `mutex_`
+    bool _read_record(std::streamoff offset, std::vector<float>& embedding);
+
+    // Rewrite the file with the most recently used half of its entries, requires `mutex_`
+    void _compact_file();
+
+public:
+    CachedEmbeddingModel(const std::shared_ptr<EmbeddingModelConfig>& config, const std::shared_ptr<EmbeddingModel>& model)
+        : EmbeddingModel(config), model_(model), model_id_(_model_id()) {
+        if (!config_->cache_path.empty()) {
+            _load_file();
+        }
+    }
+
+    std::vector<float> embed(const std::string& text, EmbeddingType type) override;
+
+    std::vector<std::vector<float>> embed_batch(const std::vector<std::string>& texts, EmbeddingType type) override;
+};
+
+} // namespace humanus
+
+#endif // HUMANUS_MEMORY_EMBEDDING_MODEL_CACHED_H
@@ -0,0 +1,223 @@
+#ifndef HUMANUS_MEMORY_EMBEDDING_MODEL_GGUF_H
+#define HUMANUS_MEMORY_EMBEDDING_MODEL_GGUF_H
+
+#include "utils.h"
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace humanus {
+
+// ggml tensor types that can be dequantized at load time
+enum GGMLType : uint32_t {
+    GGML_TYPE_F32 = 0,
+    GGML_TYPE_F16 = 1,
+    GGML_TYPE_Q8_0 = 8,
+    GGML_TYPE_BF16 = 30
+};
+
+struct GGUFTensorInfo {
+    uint32_t type;
+    std::vector<uint64_t> dims;
+    uint64_t offset;
+
+    uint64_t num_elements() const {
+        uint64_t n = 1;
+        for (auto dim : dims) {
+            n *= dim;
+        }
+        return n;
+    }
+};
+
+// Minimal GGUF (v2/v3) reader: metadata values are stored as json, tensors are located by name
+struct GGUFFile {
+    std::vector<char> buffer;
+    size_t pos = 0;
+    size_t data_offset = 0;
+    json metadata = json::object();
+    std::unordered_map<std::string, GGUFTensorInfo> tensors;
+
+    template <typename T>
+    T read() {
+        if (pos + sizeof(T) > buffer.size()) {
+            throw std::runtime_error("Unexpected end of GGUF file");
+        }
+        T value;
+        std::memcpy(&value, buffer.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    std::string read_string() {
+        auto len = read<uint64_t>();
+        if (pos + len > buffer.size()) {
+            throw std::runtime_error("Unexpected end of GGUF file");
+        }
+        std::string str(buffer.data() + pos, len);
+        pos += len;
+        return str;
+    }
+
+    json read_value(uint32_t type) {
+        switch (type) {
+            case 0: return read<uint8_t>();
+            case 1: return read<int8_t>();
+            case 2: return read<uint16_t>();
+            case 3: return read<int16_t>();
+            case 4: return read<uint32_t>();
+            case 5: return read<int32_t>();
+            case 6: return read<float>();
+            case 7: return read<uint8_t>() != 0;
+            case 8: return read_string();
+            case 9: {
+                auto elem_type = read<uint32_t>();
+                auto count = read<uint64_t>();
+                json array = json::array();
+                for (uint64_t i = 0; i < count; ++i) {
+                    array.push_back(read_value(elem_type));
+                }
+                return array;
+            }
+            case 10: return read<uint64_t>();
+            case 11: return read<int64_t>();
+            case 12: return read<double>();
+            default: throw std::runtime_error("Unsupported GGUF value type: " + std::to_string(type));
+        }
+    }
+
+    void load(const std::string& path) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) {
+            throw std::runtime_error("Failed to open model file: " + path);
+        }
+        buffer.resize(file.tellg());
+        file.seekg(0);
+        file.read(buffer.data(), buffer.size());
+
+        if (read<uint32_t>() != 0x46554747) { // "GGUF"
+            throw std::runtime_error("Not a GGUF file: " + path);
+        }
+        auto version = read<uint32_t>();
+        if (version < 2) {
+            throw std::runtime_error("Unsupported GGUF version: " + std::to_string(version));
+        }
+        auto num_tensors = read<uint64_t>();
+        auto num_kv = read<uint64_t>();
+
+        for (uint64_t i = 0; i < num_kv; ++i) {
+            auto key = read_string();
+            auto type = read<uint32_t>();
+            metadata[key] = read_value(type);
+        }
+
+        for (uint64_t i = 0; i < num_tensors; ++i) {
+            auto name = read_string();
+            GGUFTensorInfo info;
+            auto n_dims = read<uint32_t>();
+            for (uint32_t d = 0; d < n_dims; ++d) {
+                info.dims.push_back(read<uint64_t>());
+            }
+            info.type = read<uint32_t>();
+            info.offset = read<uint64_t>();
+            tensors[name] = info;
+        }
+
+        size_t alignment = metadata.value("general.alignment", 32);
+        data_offset = (pos + alignment - 1) / alignment * alignment;
+    }
+
+    bool has_tensor(const std::string& name) const {
+        return tensors.find(name) != tensors.end();
+    }
+
+    // Dequantize a tensor to float32, checking the number of elements if `expected` > 0
+    std::vector<float> tensor(const std::string& name, uint64_t expected = 0) const {
+        auto it = tensors.find(name);
+        if (it == tensors.end()) {
+            throw std::runtime_error("Missing tensor: " + name);
+        }
+        const auto& info = it->second;
+        uint64_t n = info.num_elements();
+        if (expected > 0 && n != expected) {
+            throw std::runtime_error("Unexpected shape of tensor " + name + ": " + std::to_string(n) + " elements, expected " + std::to_string(expected));
+        }
+
+        uint64_t num_bytes;
+        switch (info.type) {
+            case GGML_TYPE_F32: num_bytes = n * 4; break;
+            case GGML_TYPE_F16:
+            case GGML_TYPE_BF16: num_bytes = n * 2; break;
+            case GGML_TYPE_Q8_0: num_bytes = n / 32 * 34; break;
+            default: throw std::runtime_error("Unsupported type " + std::to_string(info.type) + " of tensor " + name);
+        }
+        if (data_offset + info.offset + num_bytes > buffer.size()) {
+            throw std::runtime_error("Tensor " + name + " exceeds file size");
+        }
+
+        const auto* src = reinterpret_cast<const uint8_t*>(buffer.data() + data_offset + info.offset);
+        std::vector<float> values(n);
+
+        auto fp16_to_fp32 = [](uint16_t h) {
+            uint32_t sign = (h & 0x8000u) << 16;
+            uint32_t exp = (h >> 10) & 0x1f;
+            uint32_t mant = h & 0x3ff;
+            uint32_t bits;
+            if (exp == 0) {
+                if (mant == 0) {
+                    bits = sign;
+                } else { // subnormal
+                    exp = 127 - 15 + 1;
+                    while ((mant & 0x400) == 0) {
+                        mant <<= 1;
+                        exp--;
+                    }
+                    bits = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+                }
+            } else if (exp == 0x1f) {
+                bits = sign | 0x7f800000u | (mant << 13);
+            } else {
+                bits = sign | ((exp + 127 - 15) << 23) | (mant << 13);
+            }
+            float f;
+            std::memcpy(&f, &bits, sizeof(f));
+            return f;
+        };
+
+        if (info.type == GGML_TYPE_F32) {
+            std::memcpy(values.data(), src, num_bytes);
+        } else if (info.type == GGML_TYPE_F16) {
+            for (uint64_t i = 0; i < n; ++i) {
+                uint16_t h;
+                std::memcpy(&h, src + 2 * i, 2);
+                values[i] = fp16_to_fp32(h);
+            }
+        } else if (info.type == GGML_TYPE_BF16) {
+            for (uint64_t i = 0; i < n; ++i) {
+                uint16_t h;
+                std::memcpy(&h, src + 2 * i, 2);
+                uint32_t bits = static_cast<uint32_t>(h) << 16;
+                std::memcpy(&values[i], &bits, sizeof(float));
+            }
+        } else { // Q8_0: blocks of (fp16 scale, 32 x int8)
+            for (uint64_t b = 0; b < n / 32; ++b) {
+                const uint8_t* block = src + b * 34;
+                uint16_t h;
+                std::memcpy(&h, block, 2);
+                float d = fp16_to_fp32(h);
+                const auto* qs = reinterpret_cast<const int8_t*>(block + 2);
+                for (int j = 0; j < 32; ++j) {
+                    values[b * 32 + j] = d * qs[j];
+                }
+            }
+        }
+
+        return values;
+    }
+};
+
+} // namespace humanus
+
+#endif // HUMANUS_MEMORY_EMBEDDING_MODEL_GGUF_H
@@ -0,0 +1,434 @@
+#include "local.h"
+#include "gguf.h"
+#include <cmath>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_AMD64) || defined(_M_X64)
+#define HUMANUS_X86
+#include <immintrin.h>
+#endif
+
+// The AVX2 kernel is always compiled on x86 with GCC / Clang and picked at runtime,
+// other compilers only get it when targeting AVX2 anyway
+#if defined(HUMANUS_X86) && (defined(__GNUC__) || defined(__clang__))
+#define HUMANUS_DOT_AVX2 __attribute__((target("avx2,fma")))
+#elif defined(HUMANUS_X86) && defined(__AVX2__)
+#define HUMANUS_DOT_AVX2
+#endif
+
+namespace humanus {
+
+#if defined(HUMANUS_DOT_AVX2)
+HUMANUS_DOT_AVX2
+static float dot_avx2(const float* a, const float* b, size_t n) {
+    size_t i = 0;
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    for (; i + 16 <= n; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    acc0 = _mm256_add_ps(acc0, acc1);
+    __m128 acc = _mm_add_ps(_mm256_castps256_ps128(acc0), _mm256_extractf128_ps(acc0, 1));
+    for (; i + 4 <= n; i += 4) {
+        acc = _mm_fmadd_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i), acc);
+    }
+    float tmp[4];
+    _mm_storeu_ps(tmp, acc);
+    float sum = tmp[0] + tmp[1] + tmp[2] + tmp[3];
+    for (; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+#endif
+
+static float dot_sse(const float* a, const float* b, size_t n) {
+    size_t i = 0;
+    float sum = 0.0f;
+#if defined(HUMANUS_X86)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (; i + 8 <= n; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    acc0 = _mm_add_ps(acc0, acc1);
+    float tmp[4];
+    _mm_storeu_ps(tmp, acc0);
+    sum = tmp[0] + tmp[1] + tmp[2] + tmp[3];
+#endif
+    for (; i < n; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// Selected once for the CPU we are running on, not the one we were compiled for
+static float (*const dot)(const float*, const float*, size_t) = [] {
+#if defined(HUMANUS_DOT_AVX2) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return dot_avx2;
+    }
+#elif defined(HUMANUS_DOT_AVX2)
+    return dot_avx2;
+#endif
+    return dot_sse;
+}();
+
+static void layer_norm(float* x, size_t n_tokens, size_t n_embd, const std::vector<float>& w, const std::vector<float>& b, float eps) {
+    for (size_t t = 0; t < n_tokens; ++t) {
+        float* row = x + t * n_embd;
+        float mean = 0.0f;
+        for (size_t i = 0; i < n_embd; ++i) {
+            mean += row[i];
+        }
+        mean /= n_embd;
+        float var = 0.0f;
+        for (size_t i = 0; i < n_embd; ++i) {
+            var += (row[i] - mean) * (row[i] - mean);
+        }
+        var /= n_embd;
+        float scale = 1.0f / std::sqrt(var + eps);
+        for (size_t i = 0; i < n_embd; ++i) {
+            row[i] = (row[i] - mean) * scale * w[i] + (b.empty() ? 0.0f : b[i]);
+        }
+    }
+}
+
+void LocalEmbeddingModel::_load(const std::string& path) {
+    if (path.empty()) {
+        throw std::invalid_argument("`model_path` is required for the local embedding model provider");
+    }
+
+    GGUFFile gguf;
+    gguf.load(path);
+    const auto& meta = gguf.metadata;
+
+    arch_ = meta.value("general.architecture", "");
+    if (arch_ != "bert" && arch_ != "nomic-bert") {
+        throw std::runtime_error("Unsupported embedding model architecture: " + arch_);
+    }
+
+    n_embd_ = meta.at(arch_ + ".embedding_length").get<int>();
+    n_layer_ = meta.at(arch_ + ".block_count").get<int>();
+    n_head_ = meta.at(arch_ + ".attention.head_count").get<int>();
+    n_ff_ = meta.at(arch_ + ".feed_forward_length").get<int>();
+    n_ctx_ = meta.value(arch_ + ".context_length", n_ctx_);
+    eps_ = meta.value(arch_ + ".attention.layer_norm_epsilon", eps_);
+    rope_freq_base_ = meta.value(arch_ + ".rope.freq_base", rope_freq_base_);
+    pooling_type_ = meta.value(arch_ + ".pooling_type", pooling_type_);
+
+    // Tokenizer
+    const auto& tokens = meta.at("tokenizer.ggml.tokens");
+    n_vocab_ = tokens.size();
+    for (int i = 0; i < n_vocab_; ++i) {
+        const auto& token = tokens[i].get_ref<const std::string&>();
+        vocab_[token] = i;
+        if (token.rfind("##", 0) == 0) {
+            phantom_space_ = false;
+        }
+    }
+    auto special_id = [&](const std::vector<std::string>& keys, const std::string& token) {
+        for (const auto& key : keys) {
+            if (meta.contains(key)) {
+                return meta[key].get<int>();
+            }
+        }
+        auto it = vocab_.find(token);
+        return it != vocab_.end() ? it->second : -1;
+    };
+    cls_id_ = special_id({"tokenizer.ggml.cls_token_id", "tokenizer.ggml.bos_token_id"}, "[CLS]");
+    sep_id_ = special_id({"tokenizer.ggml.seperator_token_id", "tokenizer.ggml.eos_token_id"}, "[SEP]");
+    unk_id_ = special_id({"tokenizer.ggml.unknown_token_id"}, "[UNK]");
+
+    // Weights
+    const uint64_t d = n_embd_, ff = n_ff_;
+    token_embd_ = gguf.tensor("token_embd.weight", d * n_vocab_);
+    if (gguf.has_tensor("token_types.weight")) {
+        token_types_ = gguf.tensor("token_types.weight");
+    }
+    if (arch_ == "bert") {
+        position_embd_ = gguf.tensor("position_embd.weight");
+        n_ctx_ = std::min<int>(n_ctx_, position_embd_.size() / d);
+    }
+    embd_norm_w_ = gguf.tensor("token_embd_norm.weight", d);
+    embd_norm_b_ = gguf.has_tensor("token_embd_norm.bias") ? gguf.tensor("token_embd_norm.bias", d) : std::vector<float>();
+
+    auto optional = [&](const std::string& name, uint64_t n) {
+        return gguf.has_tensor(name) ? gguf.tensor(name, n) : std::vector<float>();
+    };
+
+    layers_.resize(n_layer_);
+    for (int i = 0; i < n_layer_; ++i) {
+        auto& layer = layers_[i];
+        std::string prefix = "blk." + std::to_string(i) + ".";
+        if (arch_ == "bert") {
+            layer.wq = gguf.tensor(prefix + "attn_q.weight", d * d);
+            layer.bq = optional(prefix + "attn_q.bias", d);
+            layer.wk = gguf.tensor(prefix + "attn_k.weight", d * d);
+            layer.bk = optional(prefix + "attn_k.bias", d);
+            layer.wv = gguf.tensor(prefix + "attn_v.weight", d * d);
+            layer.bv = optional(prefix + "attn_v.bias", d);
+        } else {
+            layer.wqkv = gguf.tensor(prefix + "attn_qkv.weight", 3 * d * d);
+            layer.bqkv = optional(prefix + "attn_qkv.bias", 3 * d);
+        }
+        layer.wo = gguf.tensor(prefix + "attn_output.weight", d * d);
+        layer.bo = optional(prefix + "attn_output.bias", d);
+        layer.attn_norm_w = gguf.tensor(prefix + "attn_output_norm.weight", d);
+        layer.attn_norm_b = optional(prefix + "attn_output_norm.bias", d);
+        layer.w_up = gguf.tensor(prefix + "ffn_up.weight", d * ff);
+        layer.b_up = optional(prefix + "ffn_up.bias", ff);
+        layer.w_gate = optional(prefix + "ffn_gate.weight", d * ff);
+        layer.w_down = gguf.tensor(prefix + "ffn_down.weight", d * ff);
+        layer.b_down = optional(prefix + "ffn_down.bias", d);
+        layer.out_norm_w = gguf.tensor(prefix + "layer_output_norm.weight", d);
+        layer.out_norm_b = optional(prefix + "layer_output_norm.bias", d);
+    }
+
+    if (config_->embedding_dims != n_embd_) {
+        logger->warn("embedding_dims (" + std::to_string(config_->embedding_dims) + ") differs from model embedding length (" + std::to_string(n_embd_) + ")");
+    }
+
+    logger->info("Loaded local embedding model " + path + " (" + arch_ + ", " + std::to_string(n_layer_) + " layers, " + std::to_string(n_embd_) + " dims)");
+}
+
+std::vector<int> LocalEmbeddingModel::tokenize(const std::string& text) const {
+    // Basic pre-tokenization: split on whitespace, punctuation and CJK characters, lowercase ASCII
+    std::vector<std::string> words;
+    std::string word;
+
+    auto flush = [&]() {
+        if (!word.empty()) {
+            words.push_back(word);
+            word.clear();
+        }
+    };
+
+    for (size_t i = 0; i < text.size();) {
+        unsigned char c = text[i];
+        size_t len = c < 0x80 ? 1 : (c >> 5) == 0x6 ? 2 : (c >> 4) == 0xe ? 3 : (c >> 3) == 0x1e ? 4 : 1;
+        len = std::min(len, text.size() - i);
+        uint32_t cp = c;
+        if (len > 1) {
+            cp = c & (0xff >> (len + 1));
+            for (size_t j = 1; j < len; ++j) {
+                cp = (cp << 6) | (static_cast<unsigned char>(text[i + j]) & 0x3f);
+            }
+        }
+
+        bool is_space = cp == ' ' || cp == '\t' || cp == '\n' || cp == '\r' || cp == 0x3000 || cp == 0xa0;
+        bool is_control = (cp < 0x20 && !is_space) || cp == 0x7f || cp == 0xfffd;
+        bool is_punct = (cp < 0x80 && std::ispunct(static_cast<int>(cp))) || (cp >= 0x2000 && cp <= 0x206f) || (cp >= 0x3000 && cp <= 0x303f) || (cp >= 0xff00 && cp <= 0xff65);
+        bool is_cjk = (cp >= 0x4e00 && cp <= 0x9fff) || (cp >= 0x3400 && cp <= 0x4dbf) || (cp >= 0xf900 && cp <= 0xfaff) || (cp >= 0x20000 && cp <= 0x2fa1f);
+
+        if (is_space) {
+            flush();
+        } else if (is_control) {
+            // drop
+        } else if (is_punct || is_cjk) {
+            flush();
+            words.push_back(text.substr(i, len));
+        } else if (len == 1) {
+            word += static_cast<char>(std::tolower(c));
+        } else {
+            word += text.substr(i, len);
+        }
+        i += len;
+    }
+    flush();
+
+    // WordPiece: greedy longest match, a word that cannot be fully matched becomes [UNK]
+    std::vector<int> tokens{cls_id_};
+    for (const auto& w : words) {
+        if (tokens.size() + 1 >= static_cast<size_t>(n_ctx_)) {
+            break;
+        }
+        std::string current = phantom_space_ ? "\xe2\x96\x81" + w : w;
+        std::vector<int> pieces;
+        size_t start = 0;
+        bool ok = w.size() <= 100;
+        while (ok && start < current.size()) {
+            int id = -1;
+            size_t end = current.size();
+            for (; end > start; --end) {
+                std::string piece = current.substr(start, end - start);
+                if (!phantom_space_ && start > 0) {
+                    piece = "##" + piece;
+                }
+                auto it = vocab_.find(piece);
+                if (it != vocab_.end()) {
+                    id = it->second;
+                    break;
+                }
+            }
+            if (id < 0) {
+                ok = false;
+                break;
+            }
+            pieces.push_back(id);
+            start = end;
+        }
+        if (ok) {
+            tokens.insert(tokens.end(), pieces.begin(), pieces.end());
+        } else {
+            tokens.push_back(unk_id_);
+        }
+    }
+    if (tokens.size() >= static_cast<size_t>(n_ctx_)) {
+        tokens.resize(n_ctx_ - 1);
+    }
+    tokens.push_back(sep_id_);
+
+    return tokens;
+}
+
+void LocalEmbeddingModel::_linear(const float* x, size_t n_tokens, size_t n_in, const std::vector<float>& w, const std::vector<float>& b, size_t n_out, float* y) {
+    const size_t rows_per_task = 16;
+    pool_->run((n_out + rows_per_task - 1) / rows_per_task, [&](size_t task) {
+        size_t o_end = std::min(n_out, (task + 1) * rows_per_task);
+        for (size_t o = task * rows_per_task; o < o_end; ++o) {
+            const float* w_row = w.data() + o * n_in;
+            float bias = b.empty() ? 0.0f : b[o];
+            for (size_t t = 0; t < n_tokens; ++t) {
+                y[t * n_out + o] = dot(x + t * n_in, w_row, n_in) + bias;
+            }
+        }
+    });
+}
+
+std::vector<float> LocalEmbeddingModel::_forward(const std::vector<int>& tokens) {
+    const size_t n = tokens.size(), d = n_embd_, ff = n_ff_, n_head = n_head_, d_head = d / n_head;
+
+    std::vector<float> x(n * d), q(n * d), k(n * d), v(n * d), qkv, ctx(n * d), tmp(n * d), hidden(n * ff), gate;
+
+    for (size_t t = 0; t < n; ++t) {
+        size_t token = tokens[t] >= 0 && tokens[t] < n_vocab_ ? tokens[t] : (unk_id_ >= 0 ? unk_id_ : 0);
+        for (size_t i = 0; i < d; ++i) {
+            float value = token_embd_[token * d + i];
+            if (!token_types_.empty()) {
+                value += token_types_[i]; // token type 0
+            }
+            if (!position_embd_.empty()) {
+                value += position_embd_[t * d + i];
+            }
+            x[t * d + i] = value;
+        }
+    }
+    layer_norm(x.data(), n, d, embd_norm_w_, embd_norm_b_, eps_);
+
+    const float scale = 1.0f / std::sqrt(static_cast<float>(d_head));
+
+    for (const auto& layer : layers_) {
+        if (arch_ == "bert") {
+            _linear(x.data(), n, d, layer.wq, layer.bq, d, q.data());
+            _linear(x.data(), n, d, layer.wk, layer.bk, d, k.data());
+            _linear(x.data(), n, d, layer.wv, layer.bv, d, v.data());
+        } else {
+            qkv.resize(n * 3 * d);
+            _linear(x.data(), n, d, layer.wqkv, layer.bqkv, 3 * d, qkv.data());
+            for (size_t t = 0; t < n; ++t) {
+                std::memcpy(&q[t * d], &qkv[t * 3 * d], d * sizeof(float));
+                std::memcpy(&k[t * d], &qkv[t * 3 * d + d], d * sizeof(float));
+                std::memcpy(&v[t * d], &qkv[t * 3 * d + 2 * d], d * sizeof(float));
+            }
+            // Rotary position embedding (NeoX style: rotate dimension i with i + d_head / 2)
+            for (size_t t = 0; t < n; ++t) {
+                for (size_t i = 0; i < d_head / 2; ++i) {
+                    float theta = t * std::pow(rope_freq_base_, -2.0f * i / d_head);
+                    float cos_theta = std::cos(theta), sin_theta = std::sin(theta);
+                    for (size_t h = 0; h < n_head; ++h) {
+                        for (float* vec : {&q[t * d + h * d_head], &k[t * d + h * d_head]}) {
+                            float x0 = vec[i], x1 = vec[i + d_head / 2];
+                            vec[i] = x0 * cos_theta - x1 * sin_theta;
+                            vec[i + d_head / 2] = x0 * sin_theta + x1 * cos_theta;
+                        }
+                    }
+                }
+            }
+        }
+
+        // Self-attention, one task per (head, query token)
+        pool_->run(n_head * n, [&](size_t task) {
+            size_t h = task / n, i = task % n;
+            std::vector<float> scores(n);
+            const float* q_i = &q[i * d + h * d_head];
+            float max_score = -INFINITY;
+            for (size_t j = 0; j < n; ++j) {
+                scores[j] = dot(q_i, &k[j * d + h * d_head], d_head) * scale;
+                max_score = std::max(max_score, scores[j]);
+            }
+            float sum = 0.0f;
+            for (size_t j = 0; j < n; ++j) {
+                scores[j] = std::exp(scores[j] - max_score);
+                sum += scores[j];
+            }
+            float* out = &ctx[i * d + h * d_head];
+            std::fill(out, out + d_head, 0.0f);
+            for (size_t j = 0; j < n; ++j) {
+                float p = scores[j] / sum;
+                const float* v_j = &v[j * d + h * d_head];
+                for (size_t e = 0; e < d_head; ++e) {
+                    out[e] += p * v_j[e];
+                }
+            }
+        });
+
+        _linear(ctx.data(), n, d, layer.wo, layer.bo, d, tmp.data());
+        for (size_t i = 0; i < n * d; ++i) {
+            x[i] += tmp[i];
+        }
+        layer_norm(x.data(), n, d, layer.attn_norm_w, layer.attn_norm_b, eps_);
+
+        // Feed forward: GELU for bert, SwiGLU for nomic-bert
+        _linear(x.data(), n, d, layer.w_up, layer.b_up, ff, hidden.data());
+        if (!layer.w_gate.empty()) {
+            gate.resize(n * ff);
+            _linear(x.data(), n, d, layer.w_gate, {}, ff, gate.data());
+            for (size_t i = 0; i < n * ff; ++i) {
+                hidden[i] *= gate[i] / (1.0f + std::exp(-gate[i]));
+            }
+        } else {
+            for (auto& value : hidden) {
+                value = 0.5f * value * (1.0f + std::erf(value * 0.70710678f));
+            }
+        }
+        _linear(hidden.data(), n, ff, layer.w_down, layer.b_down, d, tmp.data());
+        for (size_t i = 0; i < n * d; ++i) {
+            x[i] += tmp[i];
+        }
+        layer_norm(x.data(), n, d, layer.out_norm_w, layer.out_norm_b, eps_);
+    }
+
+    std::vector<float> embedding(d, 0.0f);
+    if (pooling_type_ == 2) { // CLS
+        std::copy(x.begin(), x.begin() + d, embedding.begin());
+    } else { // mean
+        for (size_t t = 0; t < n; ++t) {
+            for (size_t i = 0; i < d; ++i) {
+                embedding[i] += x[t * d + i];
+            }
+        }
+        for (auto& value : embedding) {
+            value /= n;
+        }
+    }
+
+    float norm = std::sqrt(dot(embedding.data(), embedding.data(), d));
+    if (norm > 0.0f) {
+        for (auto& value : embedding) {
+            value /= norm;
+        }
+    }
+
+    return embedding;
+}
+
+std::vector<float> LocalEmbeddingModel::embed(const std::string& text, EmbeddingType /* type */) {
+    auto tokens = tokenize(text);
+    std::lock_guard<std::mutex> lock(forward_mutex_); // The worker pool serves one forward pass at a time
+    return _forward(tokens);
+}
+
+} // namespace humanus
@@ -0,0 +1,68 @@
+#ifndef HUMANUS_MEMORY_EMBEDDING_MODEL_LOCAL_H
+#define HUMANUS_MEMORY_EMBEDDING_MODEL_LOCAL_H
+
+#include "base.h"
+#include "../worker_pool.h"
+#include <mutex>
+
+namespace humanus {
+
+// Runs a BERT-style sentence embedding model (GGUF, architectures `bert` and `nomic-bert`) in-process on CPU.
+// Weights are dequantized to float32 at load time (F32/F16/BF16/Q8_0 are supported).
+class LocalEmbeddingModel : public EmbeddingModel {
+private:
+    struct Layer {
+        std::vector<float> wq, bq, wk, bk, wv, bv; // bert
+        std::vector<float> wqkv, bqkv;             // nomic-bert (fused)
+        std::vector<float> wo, bo;
+        std::vector<float> attn_norm_w, attn_norm_b;
+        std::vector<float> w_up, b_up, w_gate, w_down, b_down;
+        std::vector<float> out_norm_w, out_norm_b;
+    };
+
+    std::string arch_;
+    int n_vocab_ = 0;
+    int n_embd_ = 0;
+    int n_head_ = 0;
+    int n_layer_ = 0;
+    int n_ff_ = 0;
+    int n_ctx_ = 512;
+    float eps_ = 1e-12f;
+    float rope_freq_base_ = 10000.0f;
+    int pooling_type_ = 1; // 1: mean, 2: cls
+
+    std::vector<float> token_embd_, token_types_, position_embd_;
+    std::vector<float> embd_norm_w_, embd_norm_b_;
+    std::vector<Layer> layers_;
+
+    std::unordered_map<std::string, int> vocab_;
+    int cls_id_ = -1;
+    int sep_id_ = -1;
+    int unk_id_ = -1;
+    bool phantom_space_ = true; // llama.cpp converts "##xx" continuations to "xx" and word starts to "▁xx"
+
+    std::unique_ptr<WorkerPool> pool_; // Row-parallel matmuls
+    std::mutex forward_mutex_;
+
+    void _load(const std::string& path);
+
+    std::vector<float> _forward(const std::vector<int>& tokens);
+
+    // y[t][o] = sum_i x[t][i] * w[o][i] + b[o]
+    void _linear(const float* x, size_t n_tokens, size_t n_in, const std::vector<float>& w, const std::vector<float>& b, size_t n_out, float* y);
+
+public:
+    LocalEmbeddingModel(const std::shared_ptr<EmbeddingModelConfig>& config) : EmbeddingModel(config) {
+        _load(config_->model_path);
+        pool_ = std::make_unique<WorkerPool>(std::max(config_->num_threads, 0));
+    }
+
+    // WordPiece token ids of `text`, wrapped in [CLS] ... [SEP] and truncated to the context length
+    std::vector<int> tokenize(const std::string& text) const;
+
+    std::vector<float> embed(const std::string& text, EmbeddingType type) override;
+};
+
+} // namespace humanus
+
+#endif // HUMANUS_MEMORY_EMBEDDING_MODEL_LOCAL_H
@@ -1,14 +1,195 @@
 #include "oai.h"
+#include <array>
+#include <charconv>
+#include <cstring>
 
 namespace humanus {
 
+// Decode a base64 string of little-endian float32 values straight into `embedding` (assumes a little-endian host)
+static bool decode_base64_embedding(const char* first, const char* last, std::vector<float>& embedding) {
+    static const auto table = [] {
+        std::array<int8_t, 256> t;
+        t.fill(-1);
+        const char* chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        for (int i = 0; i < 64; i++) {
+            t[static_cast<unsigned char>(chars[i])] = i;
+        }
+        return t;
+    }();
+
+    while (last > first && *(last - 1) == '=') {
+        last--;
+    }
+
+    size_t num_bytes = (last - first) * 3 / 4;
+    if (num_bytes % sizeof(float) != 0) {
+        return false;
+    }
+
+    embedding.resize(num_bytes / sizeof(float));
+    auto out = reinterpret_cast<unsigned char*>(embedding.data());
+
+    uint32_t buffer = 0;
+    int bits = 0;
+    for (const char* p = first; p < last; p++) {
+        int8_t value = table[static_cast<unsigned char>(*p)];
+        if (value < 0) {
+            return false;
+        }
+        buffer = (buffer << 6) | value;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            *out++ = static_cast<unsigned char>(buffer >> bits);
+        }
+    }
+
+    return true;
+}
+
+// Parse a JSON array of numbers with std::from_chars, `first` must point at '['
+static bool parse_float_array(const char* first, const char* last, std::vector<float>& embedding, const char** end = nullptr) {
+    if (first == last || *first != '[') {
+        return false;
+    }
+    first++;
+
+    while (first < last) {
+        while (first < last && (std::isspace(static_cast<unsigned char>(*first)) || *first == ',')) {
+            first++;
+        }
+        if (first < last && *first == ']') {
+            if (end) {
+                *end = first + 1;
+            }
+            return true;
+        }
+        float value;
+        auto [ptr, ec] = std::from_chars(first, last, value);
+        if (ec != std::errc()) {
+            return false;
+        }
+        embedding.push_back(value);
+        first = ptr;
+    }
+
+    return false;
+}
+
+// Find the value of the next `key` field at or after `pos`, skipping string values equal to the key
+static size_t find_value(const std::string& body, const std::string& key, size_t pos) {
+    while (true) { // e.g. "object": "embedding", only a key is followed by ':'
+        pos = body.find(key, pos);
+        if (pos == std::string::npos) {
+            return std::string::npos;
+        }
+        pos += key.size();
+        while (pos < body.size() && std::isspace(static_cast<unsigned char>(body[pos]))) {
+            pos++;
+        }
+        if (pos < body.size() && body[pos] == ':') {
+            break;
+        }
+    }
+    pos++;
+    while (pos < body.size() && std::isspace(static_cast<unsigned char>(body[pos]))) {
+        pos++;
+    }
+    return pos < body.size() ? pos : std::string::npos;
+}
+
+bool OAIEmbeddingModel::parse_embeddings(const std::string& body, size_t num_inputs, std::vector<std::vector<float>>& embeddings, size_t embedding_dims) {
+    static const std::string embedding_key = "\"embedding\"";
+    static const std::string index_key = "\"index\"";
+
+    std::vector<std::vector<float>> parsed;
+    std::vector<size_t> indices;
+    const char* last = body.data() + body.size();
+
+    for (size_t pos = find_value(body, embedding_key, 0); pos != std::string::npos; pos = find_value(body, embedding_key, pos)) {
+        const char* first = body.data() + pos;
+        const char* end = nullptr;
+        parsed.emplace_back();
+        parsed.back().reserve(embedding_dims);
+        if (*first == '"') {
+            end = static_cast<const char*>(std::memchr(first + 1, '"', last - first - 1));
+            if (!end || !decode_base64_embedding(first + 1, end, parsed.back())) {
+                return false;
+            }
+        } else if (!parse_float_array(first, last, parsed.back(), &end)) {
+            return false;
+        }
+        pos = end - body.data();
+    }
+
+    for (size_t pos = find_value(body, index_key, 0); pos != std::string::npos; pos = find_value(body, index_key, pos)) {
+        size_t index;
+        auto [ptr, ec] = std::from_chars(body.data() + pos, last, index);
+        if (ec != std::errc()) {
+            return false;
+        }
+        indices.push_back(index);
+        pos = ptr - body.data();
+    }
+
+    if (parsed.size() != num_inputs || (!indices.empty() && indices.size() != num_inputs)) {
+        return false;
+    }
+
+    embeddings.assign(num_inputs, {});
+    for (size_t i = 0; i < num_inputs; i++) {
+        size_t index = indices.empty() ? i : indices[i];
+        if (index >= num_inputs || !embeddings[index].empty()) {
+            return false;
+        }
+        embeddings[index] = std::move(parsed[i]);
+    }
+
+    return true;
+}
+
 std::vector<float> OAIEmbeddingModel::embed(const std::string& text, EmbeddingType /* type */) {
+    return _embed(text, 1)[0];
+}
+
+std::vector<std::vector<float>> OAIEmbeddingModel::embed_batch(const std::vector<std::string>& texts, EmbeddingType /* type */) {
+    std::vector<std::vector<float>> embeddings;
+    embeddings.reserve(texts.size());
+
+    // Split into chunks that respect both the input count and the (estimated) token budget of one request
+    json chunk = json::array();
+    int chunk_tokens = 0;
+
+    auto flush = [&]() {
+        if (chunk.empty()) {
+            return;
+        }
+        auto chunk_embeddings = _embed(chunk, chunk.size());
+        std::move(chunk_embeddings.begin(), chunk_embeddings.end(), std::back_inserter(embeddings));
+        chunk = json::array();
+        chunk_tokens = 0;
+    };
+
+    for (const auto& text : texts) {
+        int num_tokens = Message::tokenizer->encode(text).size();
+        if (!chunk.empty() && (static_cast<int>(chunk.size()) >= config_->max_batch_size || chunk_tokens + num_tokens > config_->max_batch_tokens)) {
+            flush();
+        }
+        chunk.push_back(text);
+        chunk_tokens += num_tokens;
+    }
+    flush();
+
+    return embeddings;
+}
+
+std::vector<std::vector<float>> OAIEmbeddingModel::_embed(const json& input, size_t num_inputs) {
     json body = {
         {"model", config_->model},
-        {"input", text},
-        {"encoding_format", "float"}
+        {"input", input},
+        {"encoding_format", config_->encoding_format}
     };
-    
+
     std::string body_str = body.dump();
 
     int retry = 0;
@@ -20,9 +201,31 @@ std::vector<float> OAIEmbeddingModel::embed(const std::string& text, EmbeddingTy
         if (!res) {
             logger->error(std::string(__func__) + ": Failed to send request: " + httplib::to_string(res.error()));
         } else if (res->status == 200) {
+            std::vector<std::vector<float>> embeddings;
+            if (parse_embeddings(res->body, num_inputs, embeddings, config_->embedding_dims)) {
+                return embeddings;
+            }
+            // Fall back to the generic JSON path for unexpected layouts
             try {
                 json json_data = json::parse(res->body);
-                return json_data["data"][0]["embedding"].get<std::vector<float>>();
+                if (json_data["data"].size() != num_inputs) {
+                    throw std::runtime_error("Expected " + std::to_string(num_inputs) + " embeddings, got " + std::to_string(json_data["data"].size()));
+                }
+                embeddings.assign(num_inputs, {});
+                for (size_t i = 0; i < num_inputs; i++) {
+                    const auto& item = json_data["data"][i];
+                    size_t index = item.value("index", i);
+                    const auto& data = item["embedding"];
+                    if (data.is_string()) {
+                        const auto& encoded = data.get_ref<const std::string&>();
+                        if (!decode_base64_embedding(encoded.data(), encoded.data() + encoded.size(), embeddings.at(index))) {
+                            throw std::runtime_error("Invalid base64 embedding");
+                        }
+                    } else {
+                        embeddings.at(index) = data.get<std::vector<float>>();
+                    }
+                }
+                return embeddings;
             } catch (const std::exception& e) {
                 logger->error(std::string(__func__) + ": Failed to parse response: error=" + std::string(e.what()) + ", body=" + res->body);
             }
@@ -58,4 +261,4 @@ std::vector<float> OAIEmbeddingModel::embed(const std::string& text, EmbeddingTy
     throw std::runtime_error("Failed to get embedding from: " + config_->base_url + " " + config_->model);
 }
 
-} // namespace humanus
\ No newline at end of file
+} // namespace humanus
@@ -9,6 +9,9 @@ class OAIEmbeddingModel : public EmbeddingModel {
 private:
     std::unique_ptr<httplib::Client> client_;
 
+    // Send one request with `input` (a string or an array of strings) and decode `num_inputs` embeddings
+    std::vector<std::vector<float>> _embed(const json& input, size_t num_inputs);
+
 public:
     OAIEmbeddingModel(const std::shared_ptr<EmbeddingModelConfig>& config) : EmbeddingModel(config) {
         client_ = std::make_unique<httplib::Client>(config_->base_url);
@@ -17,7 +20,13 @@ public:
         });
     }
 
+    // Decode all "embedding" fields of a response body (float arrays or base64) in input order, without building
+    // a JSON DOM. Returns false for layouts it does not handle, which are left to the JSON parser
+    static bool parse_embeddings(const std::string& body, size_t num_inputs, std::vector<std::vector<float>>& embeddings, size_t embedding_dims = 0);
+
     std::vector<float> embed(const std::string& text, EmbeddingType type) override;
+
+    std::vector<std::vector<float>> embed_batch(const std::vector<std::string>& texts, EmbeddingType type) override;
 };
 
 } // namespace humanus
@@ -1,24 +1,58 @@
 #include "base.h"
 #include "hnswlib.h"
+#include <filesystem>
 
 namespace humanus {
 
 std::unordered_map<std::string, std::shared_ptr<VectorStore>> VectorStore::instances_;
+std::unordered_map<std::string, std::weak_ptr<VectorStore>> VectorStore::tenant_instances_;
+std::mutex VectorStore::instances_mutex_;
 
-std::shared_ptr<VectorStore> VectorStore::get_instance(const std::string& config_name, const std::shared_ptr<VectorStoreConfig>& config) {
-    if (instances_.find(config_name) == instances_.end()) {
-        auto config_ = config;
-        if (!config_) {
-            config_ = std::make_shared<VectorStoreConfig>(Config::get_vector_store_config(config_name));
+static std::shared_ptr<VectorStore> create_vector_store(const std::shared_ptr<VectorStoreConfig>& config) {
+    if (config->provider == "hnswlib" || config->provider == "hnswlib_mmap"
+        || config->provider == "bruteforce" || config->provider == "auto") {
+        return std::make_shared<HNSWLibVectorStore>(config);
+    }
+    throw std::invalid_argument("Unsupported embedding model provider: " + config->provider);
+}
+
+std::shared_ptr<VectorStore> VectorStore::get_instance(const std::string& config_name, const std::shared_ptr<VectorStoreConfig>& config, const std::string& tenant) {
+    std::lock_guard<std::mutex> lock(instances_mutex_);
+
+    if (tenant.empty()) {
+        if (instances_.find(config_name) == instances_.end()) {
+            auto config_ = config;
+            if (!config_) {
+                config_ = std::make_shared<VectorStoreConfig>(Config::get_vector_store_config(config_name));
+            }
+            instances_[config_name] = create_vector_store(config_);
         }
+        return instances_[config_name];
+    }
 
-        if (config_->provider == "hnswlib") {
-            instances_[config_name] = std::make_shared<HNSWLibVectorStore>(config_);
+    // Each tenant gets its own index, so searches never visit other tenants' neighbors
+    for (auto it = tenant_instances_.begin(); it != tenant_instances_.end();) {
+        if (it->second.expired()) {
+            it = tenant_instances_.erase(it);
         } else {
-            throw std::invalid_argument("Unsupported embedding model provider: " + config_->provider);
+            ++it;
+        }
+    }
+
+    auto& instance = tenant_instances_[config_name + "/" + tenant];
+    auto vector_store = instance.lock();
+    if (!vector_store) {
+        auto config_ = std::make_shared<VectorStoreConfig>(config ? *config : Config::get_vector_store_config(config_name));
+        if (config_->max_elements_per_tenant > 0) {
+            config_->max_elements = config_->max_elements_per_tenant;
+        }
+        if (!config_->path.empty()) { // Tenant names are not necessarily valid file names
+            config_->path = (std::filesystem::path(config_->path) / "tenants" / httplib::detail::MD5(tenant)).string();
         }
+        vector_store = create_vector_store(config_);
+        instance = vector_store;
     }
-    return instances_[config_name];
+    return vector_store;
 }
 
-} // namespace humanus
\ No newline at end of file
+} // namespace humanus
@@ -2,7 +2,10 @@
 #define HUMANUS_MEMORY_VECTOR_STORE_BASE_H
 
 #include "config.h"
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
 #include <unordered_map>
 #include <string>
 
@@ -11,19 +14,44 @@ namespace humanus {
 class VectorStore {
 private:
     static std::unordered_map<std::string, std::shared_ptr<VectorStore>> instances_;
+    static std::unordered_map<std::string, std::weak_ptr<VectorStore>> tenant_instances_; // Released with their last user
+    static std::mutex instances_mutex_;
+
+    std::mutex access_mutex_; // Serializes callers of stores that are not `thread_safe`
 
 protected:
     std::shared_ptr<VectorStoreConfig> config_;
+    std::atomic<size_t> version_{0}; // Bumped by every modification
 
     // Constructor
     VectorStore(const std::shared_ptr<VectorStoreConfig>& config) : config_(config) {}
 
 public:
-    // Get the singleton instance
-    static std::shared_ptr<VectorStore> get_instance(const std::string& config_name = "default", const std::shared_ptr<VectorStoreConfig>& config = nullptr);
+    // Get the singleton instance, or the separate partition of `tenant` if not empty
+    static std::shared_ptr<VectorStore> get_instance(const std::string& config_name = "default", const std::shared_ptr<VectorStoreConfig>& config = nullptr, const std::string& tenant = "");
 
     virtual ~VectorStore() = default;
 
+    int dim() const {
+        return config_->dim;
+    }
+
+    // Changes whenever the stored vectors or metadata change, so callers can cache search results
+    size_t version() const {
+        return version_.load();
+    }
+
+    // Whether the store synchronizes concurrent calls itself
+    virtual bool thread_safe() const {
+        return false;
+    }
+
+    // Held by callers around each call that may run concurrently with others (e.g. from a background worker),
+    // locked only if the store is not `thread_safe`
+    std::unique_lock<std::mutex> access_lock() {
+        return thread_safe() ? std::unique_lock<std::mutex>() : std::unique_lock<std::mutex>(access_mutex_);
+    }
+
     virtual void reset()  = 0;
 
     /**
@@ -36,16 +64,72 @@ public:
                         const size_t vector_id, 
                         const MemoryItem& metadata = MemoryItem()) = 0;
 
+    /**
+     * @brief Insert several vectors with metadata
+     * @param vectors vector data
+     * @param vector_ids vector IDs, one per vector
+     * @param metadatas metadata, one per vector (or empty)
+     */
+    virtual void insert_batch(const std::vector<std::vector<float>>& vectors,
+                              const std::vector<size_t>& vector_ids,
+                              const std::vector<MemoryItem>& metadatas = {}) {
+        if (vector_ids.size() != vectors.size() || (!metadatas.empty() && metadatas.size() != vectors.size())) {
+            throw std::invalid_argument("insert_batch expects one vector id (and metadata) per vector");
+        }
+        for (size_t i = 0; i < vectors.size(); ++i) {
+            insert(vectors[i], vector_ids[i], metadatas.empty() ? MemoryItem() : metadatas[i]);
+        }
+    }
+
     /**
      * @brief Search similar vectors
      * @param query query vector
      * @param limit limit of returned results
      * @param filter optional filter (returns true for allowed vectors)
+     * @param ef size of the candidate list of approximate searches (0 for the configured one)
      * @return list of similar vectors
      */
     virtual std::vector<MemoryItem> search(const std::vector<float>& query, 
                                             size_t limit = 5, 
-                                            const FilterFunc& filter = nullptr) = 0;
+                                            const FilterFunc& filter = nullptr,
+                                            size_t ef = 0) = 0;
+
+    /**
+     * @brief Search similar vectors with a typed filter
+     * @param query query vector
+     * @param limit limit of returned results
+     * @param filter conditions on the metadata of returned vectors
+     * @param ef size of the candidate list of approximate searches (0 for the configured one)
+     * @return list of similar vectors
+     */
+    virtual std::vector<MemoryItem> search(const std::vector<float>& query,
+                                            size_t limit,
+                                            const MemoryFilter& filter,
+                                            size_t ef = 0) {
+        return search(query, limit, [&filter](const MemoryItem& item) {
+            return filter.matches(item);
+        }, ef);
+    }
+
+    /**
+     * @brief Search similar vectors for several queries
+     * @param queries query vectors
+     * @param limit limit of returned results per query
+     * @param filter optional filter (returns true for allowed vectors), may be called concurrently
+     * @param ef size of the candidate list of approximate searches (0 for the configured one)
+     * @return list of similar vectors for each query
+     */
+    virtual std::vector<std::vector<MemoryItem>> search_batch(const std::vector<std::vector<float>>& queries,
+                                                              size_t limit = 5,
+                                                              const FilterFunc& filter = nullptr,
+                                                              size_t ef = 0) {
+        std::vector<std::vector<MemoryItem>> results;
+        results.reserve(queries.size());
+        for (const auto& query : queries) {
+            results.push_back(search(query, limit, filter, ef));
+        }
+        return results;
+    }
 
     /**
      * @brief Remove a vector by ID
@@ -75,6 +159,17 @@ public:
      */
     virtual void set(size_t vector_id, const MemoryItem& metadata) = 0;
 
+    /**
+     * @brief Check whether a memory with the given content is stored
+     * @param hash content hash (`MemoryItem::hash`)
+     * @return true if at least one stored memory has this hash
+     */
+    virtual bool contains_hash(const std::string& hash) {
+        return !list(1, [&hash](const MemoryItem& item) {
+            return item.hash == hash;
+        }).empty();
+    }
+
     /**
      * @brief List all memories
      * @param limit optional limit of returned results
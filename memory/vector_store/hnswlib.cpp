@@ -1,39 +1,296 @@
 #include "hnswlib/hnswlib.h"
 #include "hnswlib.h"
+#include "hnswlib_mmap.h"
 #include <map>
 #include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <unordered_set>
 
 namespace humanus {
 
+namespace {
+
+// Little helpers for the binary snapshot / log formats (host byte order)
+template <typename T>
+void put(std::string& buffer, const T& value) {
+    buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void put_string(std::string& buffer, const std::string& str) {
+    put<uint32_t>(buffer, str.size());
+    buffer.append(str);
+}
+
+void put_memory_item(std::string& buffer, const MemoryItem& item) {
+    put<uint64_t>(buffer, item.id);
+    put_string(buffer, item.memory);
+    put_string(buffer, item.hash);
+    put<int64_t>(buffer, item.created_at);
+    put<int64_t>(buffer, item.updated_at);
+    put_string(buffer, item.tenant);
+    put<uint32_t>(buffer, item.tags.size());
+    for (const auto& tag : item.tags) {
+        put_string(buffer, tag);
+    }
+}
+
+struct Reader {
+    const char* pos;
+    const char* end;
+
+    template <typename T>
+    T get() {
+        if (end - pos < static_cast<ptrdiff_t>(sizeof(T))) {
+            throw std::runtime_error("Unexpected end of data");
+        }
+        T value;
+        std::memcpy(&value, pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    std::string get_string() {
+        auto size = get<uint32_t>();
+        if (end - pos < static_cast<ptrdiff_t>(size)) {
+            throw std::runtime_error("Unexpected end of data");
+        }
+        std::string str(pos, size);
+        pos += size;
+        return str;
+    }
+
+    MemoryItem get_memory_item() {
+        MemoryItem item;
+        item.id = get<uint64_t>();
+        item.memory = get_string();
+        item.hash = get_string();
+        item.created_at = get<int64_t>();
+        item.updated_at = get<int64_t>();
+        item.tenant = get_string();
+        item.tags.resize(get<uint32_t>());
+        for (auto& tag : item.tags) {
+            tag = get_string();
+        }
+        return item;
+    }
+};
+
+uint32_t fnv1a(const char* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+std::string read_file(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Cannot open " + path.string());
+    }
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// Prepare `index.addPoint(data, label, replace_deleted)` on an index reusing deleted elements: a deleted `label`
+// is revived to be updated in place. Returns whether `label` is new, only then it may replace a deleted element.
+bool prepare_add(hnswlib::HierarchicalNSW<float>& index, hnswlib::labeltype label) {
+    auto it = index.label_lookup_.find(label);
+    if (it == index.label_lookup_.end()) {
+        return true;
+    }
+    if (index.isMarkedDeleted(it->second)) {
+        index.unmarkDelete(label);
+    }
+    return false;
+}
+
+// Sampled searches per `ef_search` adjustment, and the bounds it is adjusted within
+const size_t TUNER_WINDOW = 32;
+const size_t MIN_EF_SEARCH = 10;
+
+// Rebuilding a graph is not worth it for a handful of deleted elements
+const size_t MIN_COMPACTION_DELETED = 64;
+
+const uint32_t METADATA_MAGIC = 0x4d454d48; // "HMEM"
+const uint32_t METADATA_VERSION = 3;
+
+// Kind of `<seq>.index` (metadata version 3)
+const uint32_t INDEX_HNSW = 0;
+const uint32_t INDEX_FLAT = 1;
+
+} // namespace
+
+HNSWLibVectorStore::~HNSWLibVectorStore() {
+    if (compaction_.joinable()) {
+        compaction_.join();
+    }
+}
+
 void HNSWLibVectorStore::reset() {
+    auto lock = _write_lock();
+    _reset();
+    if (!config_->path.empty()) {
+        _snapshot();
+    }
+}
+
+void HNSWLibVectorStore::_reset() {
     if (hnsw) {
         hnsw.reset();
     }
+    if (flat) {
+        flat.reset();
+    }
     if (space) {
         space.reset();
     }
 
-    cache_map.clear();
-    metadata_list.clear();
-    
+    size_t capacity = config_->max_elements;
+    slot_of_.clear();
+    ids_.assign(capacity, 0);
+    created_at_.assign(capacity, 0);
+    updated_at_.assign(capacity, 0);
+    tenant_.assign(capacity, 0);
+    tags_.assign(capacity, {});
+    memory_.assign(capacity, {});
+    hash_.assign(capacity, {});
+    live_.assign(capacity, 0);
+    vectors_.assign(_rerank() ? capacity * config_->dim : 0, 0.0f);
+    referenced_ = std::make_unique<std::atomic<bool>[]>(capacity);
+    free_slots_.clear();
+    for (size_t slot = capacity; slot > 0; slot--) {
+        free_slots_.push_back(slot - 1);
+    }
+    clock_hand_ = 0;
+    intern_ids_ = {{"", 0}};
+    interned_ = {""};
+    tenant_count_ = {0};
+    tag_count_ = {0};
+    hash_count_.clear();
+    version_++;
+
+    ef_search_ = static_cast<size_t>(std::max(config_->ef_search, 1));
+    {
+        std::lock_guard<std::mutex> lock(tuner_mutex_);
+        tuner_samples_ = tuner_relevant_ = tuner_found_ = 0;
+    }
+
+    std::shared_ptr<hnswlib::SpaceInterface<float>> float_space;
     if (config_->metric == VectorStoreConfig::Metric::L2) {
-        space = std::make_shared<hnswlib::L2Space>(config_->dim);
-        hnsw = std::make_shared<hnswlib::HierarchicalNSW<float>>(space.get(), config_->max_elements, config_->M, config_->ef_construction);
-    } else if (config_->metric == VectorStoreConfig::Metric::IP) {
-        space = std::make_shared<hnswlib::InnerProductSpace>(config_->dim);
-        hnsw = std::make_shared<hnswlib::HierarchicalNSW<float>>(space.get(), config_->max_elements, config_->M, config_->ef_construction);
+        float_space = std::make_shared<hnswlib::L2Space>(config_->dim);
+    } else if (config_->metric == VectorStoreConfig::Metric::IP || config_->metric == VectorStoreConfig::Metric::COSINE) {
+        float_space = std::make_shared<hnswlib::InnerProductSpace>(config_->dim);
     } else {
         throw std::invalid_argument("Unsupported metric: " + std::to_string(static_cast<size_t>(config_->metric)));
     }
+
+    bool l2 = config_->metric == VectorStoreConfig::Metric::L2;
+    if (config_->quantization == VectorStoreConfig::Quantization::NONE) {
+        space = float_space;
+    } else if (config_->quantization == VectorStoreConfig::Quantization::FP16) {
+        space = l2 ? std::shared_ptr<hnswlib::SpaceInterface<float>>(std::make_shared<hnswlib::L2SpaceFP16>(config_->dim))
+                   : std::make_shared<hnswlib::InnerProductSpaceFP16>(config_->dim);
+    } else if (config_->quantization == VectorStoreConfig::Quantization::INT8) {
+        space = l2 ? std::shared_ptr<hnswlib::SpaceInterface<float>>(std::make_shared<hnswlib::L2SpaceInt8>(config_->dim))
+                   : std::make_shared<hnswlib::InnerProductSpaceInt8>(config_->dim);
+    } else {
+        throw std::invalid_argument("Unsupported quantization: " + std::to_string(static_cast<size_t>(config_->quantization)));
+    }
+    full_space = _rerank() ? float_space : nullptr;
+
+    if (config_->provider == "bruteforce" || _auto()) {
+        flat = std::make_shared<hnswlib::BruteforceSearch<float>>(space.get(), config_->max_elements);
+    } else {
+        hnsw = _new_hnsw(space.get(), config_->max_elements, mmap_alternate_);
+    }
+    index_generation_++;
 }
 
-void HNSWLibVectorStore::insert(const std::vector<float>& vector, const size_t vector_id, const MemoryItem& metadata) {
-    if (cache_map.size() >= config_->max_elements) {
-        remove(metadata_list.back().id);
+std::shared_ptr<hnswlib::HierarchicalNSW<float>> HNSWLibVectorStore::_new_hnsw(hnswlib::SpaceInterface<float>* s, size_t capacity, bool alternate) const {
+    if (_mmap()) {
+        std::filesystem::create_directories(config_->path);
+        return std::make_shared<MMapHierarchicalNSW>(s, _mmap_file(alternate), capacity, config_->M, config_->ef_construction, true);
+    }
+    return std::make_shared<hnswlib::HierarchicalNSW<float>>(s, capacity, config_->M, config_->ef_construction, 100, true);
+}
+
+void HNSWLibVectorStore::_resize_hnsw(hnswlib::HierarchicalNSW<float>& index, size_t capacity) const {
+    if (_mmap()) {
+        static_cast<MMapHierarchicalNSW&>(index).resizeIndex(capacity); // Not virtual
+    } else {
+        index.resizeIndex(capacity);
     }
+}
+
+size_t HNSWLibVectorStore::_bytes_per_element() const {
+    size_t bytes = sizeof(size_t) + 2 * sizeof(long long) + sizeof(uint32_t) + sizeof(std::vector<uint32_t>) + 2 * sizeof(std::string)
+        + sizeof(uint8_t) + sizeof(std::atomic<bool>);
+    if (_rerank()) {
+        bytes += config_->dim * sizeof(float);
+    }
+    bytes += 4 * sizeof(size_t); // Label map node
+    if (flat) {
+        bytes += flat->size_per_element_;
+    } else {
+        bytes += hnsw->size_data_per_element_ + sizeof(void*) + sizeof(int) + sizeof(std::mutex) + sizeof(hnswlib::vl_type);
+    }
+    return bytes;
+}
+
+void HNSWLibVectorStore::_resize(size_t capacity) {
+    size_t old_capacity = live_.size();
+    if (capacity <= old_capacity) {
+        return;
+    }
+
+    if (flat) {
+        if (capacity > flat->maxelements_) {
+            flat->resizeIndex(capacity);
+        }
+    } else if (capacity > hnsw->max_elements_) {
+        _resize_hnsw(*hnsw, capacity);
+    }
+
+    ids_.resize(capacity, 0);
+    created_at_.resize(capacity, 0);
+    updated_at_.resize(capacity, 0);
+    tenant_.resize(capacity, 0);
+    tags_.resize(capacity);
+    memory_.resize(capacity);
+    hash_.resize(capacity);
+    live_.resize(capacity, 0);
+    if (_rerank()) {
+        vectors_.resize(capacity * config_->dim, 0.0f);
+    }
+    auto referenced = std::make_unique<std::atomic<bool>[]>(capacity);
+    for (size_t slot = 0; slot < old_capacity; slot++) {
+        referenced[slot].store(referenced_[slot].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    referenced_ = std::move(referenced);
+    for (size_t slot = capacity; slot > old_capacity; slot--) {
+        free_slots_.push_back(slot - 1);
+    }
+}
+
+void HNSWLibVectorStore::_reserve(size_t num_new, const std::unordered_set<size_t>* pinned) {
+    size_t needed = slot_of_.size() + num_new;
+    if (needed > live_.size() && config_->memory_budget_mb > 0) {
+        size_t max_capacity = static_cast<size_t>(config_->memory_budget_mb) * 1024 * 1024 / _bytes_per_element();
+        size_t capacity = std::min(std::max(live_.size() * 2, needed), max_capacity);
+        if (capacity > live_.size()) {
+            _resize(capacity);
+            logger->info("Vector store capacity grown to " + std::to_string(capacity) + " elements");
+        }
+    }
+    while (slot_of_.size() + num_new > live_.size() && _evict(pinned)) {}
+}
+
+void HNSWLibVectorStore::insert(const std::vector<float>& vector, const size_t vector_id, const MemoryItem& metadata) {
+    auto lock = _write_lock();
+
+    _reserve(slot_of_.find(vector_id) == slot_of_.end() ? 1 : 0);
 
-    hnsw->addPoint(vector.data(), vector_id);
-    
     auto now = std::chrono::system_clock::now().time_since_epoch().count();
     MemoryItem _metadata = metadata;
     if (_metadata.created_at < 0) {
@@ -42,53 +299,537 @@ void HNSWLibVectorStore::insert(const std::vector<float>& vector, const size_t v
     if (_metadata.updated_at < 0) {
         _metadata.updated_at = now;
     }
-    
-    set(vector_id, _metadata);
+
+    _apply(WalOp::INSERT, vector_id, &vector, &_metadata);
+    _log(WalOp::INSERT, vector_id, &vector, &_metadata);
+
+    lock.unlock();
+    _snapshot_if_due();
 }
 
-std::vector<MemoryItem> HNSWLibVectorStore::search(const std::vector<float>& query, size_t limit, const FilterFunc& filter) {
+void HNSWLibVectorStore::insert_batch(const std::vector<std::vector<float>>& vectors, const std::vector<size_t>& vector_ids, const std::vector<MemoryItem>& metadatas) {
+    if (vector_ids.size() != vectors.size() || (!metadatas.empty() && metadatas.size() != vectors.size())) {
+        throw std::invalid_argument("insert_batch expects one vector id (and metadata) per vector");
+    }
+
+    auto lock = _write_lock();
+
+    // Positions to insert, the last occurrence of an id wins like with consecutive inserts
+    std::vector<size_t> batch;
+    {
+        std::unordered_set<size_t> seen;
+        for (size_t i = vectors.size(); i > 0; i--) {
+            if (seen.insert(vector_ids[i - 1]).second) {
+                batch.push_back(i - 1);
+            }
+        }
+        std::reverse(batch.begin(), batch.end());
+    }
+
+    // Ids of the batch already stored must not be evicted to make room for the rest of it
+    std::unordered_set<size_t> pinned;
+    auto reserve = [&]() {
+        pinned.clear();
+        for (size_t i : batch) {
+            if (slot_of_.find(vector_ids[i]) != slot_of_.end()) {
+                pinned.insert(vector_ids[i]);
+            }
+        }
+        _reserve(batch.size() - pinned.size(), &pinned);
+    };
+    reserve();
+    if (batch.size() > live_.size()) { // The oldest ones would be evicted by the rest of the batch anyway
+        batch.erase(batch.begin(), batch.end() - live_.size());
+        reserve();
+    }
+
+    auto now = std::chrono::system_clock::now().time_since_epoch().count();
+    std::vector<MemoryItem> items;
+    items.reserve(batch.size());
+    for (size_t i : batch) {
+        items.push_back(metadatas.empty() ? MemoryItem() : metadatas[i]);
+        if (items.back().created_at < 0) {
+            items.back().created_at = now;
+        }
+        if (items.back().updated_at < 0) {
+            items.back().updated_at = now;
+        }
+    }
+
+    if (flat) { // Appending to the flat index is a copy, nothing to gain from threads
+        for (size_t j = 0; j < batch.size(); j++) {
+            _apply(WalOp::INSERT, vector_ids[batch[j]], &vectors[batch[j]], &items[j]);
+            _log(WalOp::INSERT, vector_ids[batch[j]], &vectors[batch[j]], &items[j]);
+        }
+        lock.unlock();
+        _snapshot_if_due();
+        return;
+    }
+
+    std::vector<uint8_t> is_new(batch.size());
+    for (size_t j = 0; j < batch.size(); j++) {
+        is_new[j] = prepare_add(*hnsw, vector_ids[batch[j]]);
+        if (compacting_) {
+            dirty_.insert(vector_ids[batch[j]]);
+        }
+    }
+
+    // hnswlib supports concurrent `addPoint` (per label and per element locks)
+    std::vector<uint8_t> added(batch.size(), 0);
+    std::exception_ptr error;
+    try {
+        pool_.run(batch.size(), [&](size_t j) {
+            std::vector<float> normalized;
+            std::vector<char> buffer;
+            const float* data = _prepare(vectors[batch[j]], normalized);
+            hnsw->addPoint(_encode(data, buffer), vector_ids[batch[j]], is_new[j] != 0);
+            added[j] = 1;
+        });
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    // Metadata of everything indexed first, so that a snapshot taken while logging is complete
+    for (size_t j = 0; j < batch.size(); j++) {
+        if (!added[j]) {
+            continue;
+        }
+        _set(vector_ids[batch[j]], items[j]);
+        if (_rerank()) {
+            std::vector<float> normalized;
+            _set_vector(vector_ids[batch[j]], _prepare(vectors[batch[j]], normalized));
+        }
+    }
+    for (size_t j = 0; j < batch.size(); j++) {
+        if (added[j]) {
+            _log(WalOp::INSERT, vector_ids[batch[j]], &vectors[batch[j]], &items[j]);
+        }
+    }
+
+    if (error) {
+        for (size_t j = 0; j < batch.size(); j++) { // Deleted ids revived by `prepare_add` but not re-added
+            if (!added[j] && !is_new[j] && slot_of_.find(vector_ids[batch[j]]) == slot_of_.end()) {
+                hnsw->markDelete(vector_ids[batch[j]]);
+            }
+        }
+        std::rethrow_exception(error);
+    }
+
+    lock.unlock();
+    _snapshot_if_due();
+}
+
+std::vector<MemoryItem> HNSWLibVectorStore::search(const std::vector<float>& query, size_t limit, const FilterFunc& filter, size_t ef) {
+    auto lock = _read_lock();
+
     auto filte_wrapper = filter ? std::make_unique<HNSWLibFilterFunctorWrapper>(*this, filter) : nullptr;
-    auto results = hnsw->searchKnn(query.data(), limit, filte_wrapper.get());
-    std::vector<MemoryItem> memory_items;
-    
+    return _search(query, limit, filte_wrapper.get(), ef);
+}
+
+std::vector<MemoryItem> HNSWLibVectorStore::search(const std::vector<float>& query, size_t limit, const MemoryFilter& filter, size_t ef) {
+    auto lock = _read_lock();
+
+    HNSWLibMemoryFilterFunctor filter_functor(*this, filter);
+    if (!filter_functor.is_satisfiable()) {
+        return {};
+    }
+    return _search(query, limit, &filter_functor, ef);
+}
+
+std::vector<std::vector<MemoryItem>> HNSWLibVectorStore::search_batch(const std::vector<std::vector<float>>& queries, size_t limit, const FilterFunc& filter, size_t ef) {
+    auto lock = _read_lock();
+
+    auto filter_wrapper = filter ? std::make_unique<HNSWLibFilterFunctorWrapper>(*this, filter) : nullptr;
+    std::vector<std::vector<MemoryItem>> results(queries.size());
+    if (flat && flat->cur_element_count >= 2 * hnswlib::BruteforceSearch<float>::MIN_ELEMENTS_PER_THREAD) {
+        for (size_t i = 0; i < queries.size(); i++) { // Each scan is parallel already
+            results[i] = _search(queries[i], limit, filter_wrapper.get(), ef);
+        }
+    } else {
+        pool_.run(queries.size(), [&](size_t i) {
+            results[i] = _search(queries[i], limit, filter_wrapper.get(), ef);
+        });
+    }
+    return results;
+}
+
+std::vector<MemoryItem> HNSWLibVectorStore::_search(const std::vector<float>& query, size_t limit, HNSWLibSlotFilterFunctor* filter, size_t ef) const {
+    std::vector<float> normalized;
+    std::vector<char> buffer;
+    const float* query_data = _prepare(query, normalized);
+    const void* encoded_query = _encode(query_data, buffer);
+    size_t k = _rerank() ? limit * config_->rerank_factor : limit;
+
+    bool tune = false;
+    if (ef == 0) {
+        ef = ef_search_.load(std::memory_order_relaxed);
+        tune = !filter && !flat && config_->recall_target > 0
+            && searches_.fetch_add(1, std::memory_order_relaxed) % std::max(config_->recall_sample_interval, 1) == 0;
+    }
+    ef = std::max(ef, k);
+
+    std::priority_queue<std::pair<float, hnswlib::labeltype>> results;
+    if (filter && !flat) { // The flat index is scanned exactly anyway
+        size_t estimate = _estimate(*filter);
+        if (estimate <= static_cast<size_t>(std::max(config_->filter_scan_threshold, 0))) {
+            results = _scan(encoded_query, k, filter);
+        } else {
+            // Only a fraction of the visited elements is allowed, widen the candidate list accordingly
+            ef = std::min(ef * slot_of_.size() / estimate, std::max(ef, estimate));
+            results = hnsw->searchKnn(encoded_query, k, filter, ef);
+            if (results.size() < std::min(k, estimate)) { // Matches are not reachable from where the search went
+                results = _scan(encoded_query, k, filter);
+            }
+        }
+    } else {
+        results = _index_search(encoded_query, k, filter, ef);
+        if (tune) {
+            _tune(encoded_query, k, results);
+        }
+    }
+
+    // (distance, slot), furthest first
+    std::vector<std::pair<float, uint32_t>> candidates;
     while (!results.empty()) {
         const auto& [distance, id] = results.top();
 
+        int64_t slot = _find(id);
+        if (slot >= 0) {
+            candidates.emplace_back(distance, slot);
+        }
+
         results.pop();
-        
-        if (cache_map.find(id) != cache_map.end()) {
-            MemoryItem item = *cache_map[id]; 
-            item.score = distance;
-            memory_items.push_back(item);
+    }
+
+    if (_rerank()) {
+        auto dist_func = full_space->get_dist_func();
+        auto dist_func_param = full_space->get_dist_func_param();
+        for (auto& [distance, slot] : candidates) {
+            distance = dist_func(query_data, vectors_.data() + static_cast<size_t>(slot) * config_->dim, dist_func_param);
         }
+        std::sort(candidates.begin(), candidates.end());
+        if (candidates.size() > limit) {
+            candidates.resize(limit);
+        }
+        std::reverse(candidates.begin(), candidates.end());
+    }
+
+    std::vector<MemoryItem> memory_items;
+    memory_items.reserve(candidates.size());
+    for (const auto& [distance, slot] : candidates) {
+        memory_items.push_back(_materialize(slot));
+        memory_items.back().score = distance;
     }
-    
+
     return memory_items;
 }
 
-void HNSWLibVectorStore::remove(size_t vector_id) {
-    hnsw->markDelete(vector_id);
-    auto it = cache_map.find(vector_id);
-    if (it != cache_map.end()) {
-        metadata_list.erase(it->second);
-        cache_map.erase(it);
+void HNSWLibVectorStore::_index_add(const void* data, size_t vector_id) {
+    if (!flat) {
+        if (compacting_) {
+            dirty_.insert(vector_id);
+        }
+        hnsw->addPoint(data, vector_id, prepare_add(*hnsw, vector_id));
+        return;
+    }
+    flat->addPoint(data, vector_id); // Replaces the vector of an existing label
+    if (_auto() && flat->cur_element_count > static_cast<size_t>(std::max(config_->auto_threshold, 0))) {
+        _build_hnsw();
     }
 }
 
-void HNSWLibVectorStore::update(size_t vector_id, const std::vector<float>& vector, const MemoryItem& metadata) {
-    if (!vector.empty()) {
+void HNSWLibVectorStore::_index_remove(size_t vector_id) {
+    if (flat) {
+        flat->removePoint(vector_id);
+    } else {
+        if (compacting_) {
+            dirty_.insert(vector_id);
+        }
         hnsw->markDelete(vector_id);
-        hnsw->addPoint(vector.data(), vector_id);
+    }
+}
+
+std::priority_queue<std::pair<float, hnswlib::labeltype>> HNSWLibVectorStore::_index_search(const void* query, size_t k, hnswlib::BaseFilterFunctor* filter, size_t ef) const {
+    if (flat) {
+        return flat->searchKnn(query, k, filter);
+    }
+    return hnsw->searchKnn(query, k, filter, ef);
+}
+
+void HNSWLibVectorStore::_tune(const void* query, size_t k, std::priority_queue<std::pair<float, hnswlib::labeltype>> results) const {
+    auto exact = _scan(query, k, nullptr);
+    if (exact.empty()) {
+        return;
+    }
+    std::unordered_set<hnswlib::labeltype> found;
+    for (; !results.empty(); results.pop()) {
+        found.insert(results.top().second);
+    }
+    size_t relevant = exact.size(), num_found = 0;
+    for (; !exact.empty(); exact.pop()) {
+        num_found += found.count(exact.top().second);
+    }
+
+    std::lock_guard<std::mutex> lock(tuner_mutex_);
+    tuner_relevant_ += relevant;
+    tuner_found_ += num_found;
+    if (++tuner_samples_ < TUNER_WINDOW) {
+        return;
+    }
+
+    float recall = static_cast<float>(tuner_found_) / tuner_relevant_;
+    float target = config_->recall_target;
+    size_t ef = ef_search_.load(std::memory_order_relaxed);
+    size_t tuned = ef;
+    if (recall < target) {
+        tuned = std::min(ef + std::max<size_t>(ef / 2, 1), std::max(slot_of_.size(), MIN_EF_SEARCH));
+    } else if (recall >= target + (1.0f - target) / 2) { // Comfortably above, so that it does not oscillate around the target
+        tuned = std::max(ef - ef / 4, MIN_EF_SEARCH);
+    }
+    tuner_samples_ = tuner_relevant_ = tuner_found_ = 0;
+    if (tuned != ef) {
+        ef_search_.store(tuned, std::memory_order_relaxed);
+        logger->debug("Tuned ef_search from " + std::to_string(ef) + " to " + std::to_string(tuned) + " (sampled recall@k " + std::to_string(recall) + ")");
+    }
+}
+
+void HNSWLibVectorStore::_build_hnsw() {
+    auto start = std::chrono::steady_clock::now();
+    hnsw = _new_hnsw(space.get(), flat->maxelements_, mmap_alternate_);
+    for (size_t i = 0; i < flat->cur_element_count; i++) {
+        const char* element = flat->data_ + flat->size_per_element_ * i;
+        hnswlib::labeltype label;
+        std::memcpy(&label, element + flat->data_size_, sizeof(label));
+        hnsw->addPoint(element, label);
+    }
+    flat.reset();
+    index_generation_++;
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    logger->info("Built HNSW index over " + std::to_string(hnsw->cur_element_count) + " vectors in " + std::to_string(elapsed) + "ms");
+}
+
+size_t HNSWLibVectorStore::_estimate(const HNSWLibSlotFilterFunctor& filter) const {
+    auto [bound, exact] = filter.bound();
+    if (exact || bound <= static_cast<size_t>(std::max(config_->filter_scan_threshold, 0))) {
+        return bound;
     }
 
+    // Evaluate the filter on live slots spread evenly over all slots
+    const size_t sample_size = 256;
+    size_t stride = std::max<size_t>(1, live_.size() / sample_size);
+    size_t num_sampled = 0;
+    size_t num_allowed = 0;
+    for (size_t offset = 0; offset < stride && num_sampled < sample_size; offset++) {
+        for (size_t slot = offset; slot < live_.size() && num_sampled < sample_size; slot += stride) {
+            if (live_[slot]) {
+                num_sampled++;
+                num_allowed += filter.allows(slot);
+            }
+        }
+    }
+    if (num_sampled == 0) {
+        return 0;
+    }
+    return std::min(bound, (num_allowed * slot_of_.size() + num_sampled - 1) / num_sampled);
+}
+
+std::priority_queue<std::pair<float, hnswlib::labeltype>> HNSWLibVectorStore::_scan(const void* query, size_t k, const HNSWLibSlotFilterFunctor* filter) const {
+    auto dist_func = space->get_dist_func();
+    auto dist_func_param = space->get_dist_func_param();
+
+    std::priority_queue<std::pair<float, hnswlib::labeltype>> results;
+    for (uint32_t slot = 0; slot < live_.size(); slot++) {
+        if (!live_[slot] || (filter && !filter->allows(slot))) {
+            continue;
+        }
+        auto it = hnsw->label_lookup_.find(ids_[slot]); // No concurrent writers under the shared lock
+        if (it == hnsw->label_lookup_.end() || hnsw->isMarkedDeleted(it->second)) {
+            continue; // Metadata without a vector
+        }
+        float distance = dist_func(query, hnsw->getDataByInternalId(it->second), dist_func_param);
+        if (results.size() < k || distance < results.top().first) {
+            results.emplace(distance, ids_[slot]);
+            if (results.size() > k) {
+                results.pop();
+            }
+        }
+    }
+    return results;
+}
+
+const float* HNSWLibVectorStore::_prepare(const std::vector<float>& vector, std::vector<float>& normalized) const {
+    if (vector.size() != static_cast<size_t>(config_->dim)) {
+        throw std::invalid_argument("Vector dimension " + std::to_string(vector.size()) + " does not match " + std::to_string(config_->dim));
+    }
+    if (config_->metric != VectorStoreConfig::Metric::COSINE) {
+        return vector.data();
+    }
+
+    normalized.resize(config_->dim);
+    hnswlib::NormalizeVector(vector.data(), normalized.data(), config_->dim);
+    return normalized.data();
+}
+
+const void* HNSWLibVectorStore::_encode(const float* vector, std::vector<char>& buffer) const {
+    if (config_->quantization == VectorStoreConfig::Quantization::NONE) {
+        return vector;
+    }
+
+    buffer.resize(space->get_data_size());
+    if (config_->quantization == VectorStoreConfig::Quantization::FP16) {
+        hnswlib::EncodeFP16(vector, buffer.data(), config_->dim);
+    } else {
+        hnswlib::EncodeInt8(vector, buffer.data(), config_->dim);
+    }
+    return buffer.data();
+}
+
+void HNSWLibVectorStore::_decode(const void* data, float* vector) const {
+    if (config_->quantization == VectorStoreConfig::Quantization::FP16) {
+        hnswlib::DecodeFP16(data, vector, config_->dim);
+    } else if (config_->quantization == VectorStoreConfig::Quantization::INT8) {
+        hnswlib::DecodeInt8(data, vector, config_->dim);
+    } else {
+        std::memcpy(vector, data, config_->dim * sizeof(float));
+    }
+}
+
+void HNSWLibVectorStore::_set_vector(size_t vector_id, const float* vector) {
+    auto it = slot_of_.find(vector_id);
+    if (it != slot_of_.end()) {
+        std::copy(vector, vector + config_->dim, vectors_.begin() + static_cast<size_t>(it->second) * config_->dim);
+    }
+}
+
+void HNSWLibVectorStore::remove(size_t vector_id) {
+    auto lock = _write_lock();
+    _remove(vector_id);
+    _log(WalOp::REMOVE, vector_id, nullptr, nullptr);
+    _schedule_compaction();
+
+    lock.unlock();
+    _snapshot_if_due();
+}
+
+void HNSWLibVectorStore::_schedule_compaction() {
+    if (flat || compacting_ || config_->compaction_threshold <= 0) {
+        return;
+    }
+    size_t num_deleted = hnsw->getDeletedCount();
+    if (num_deleted < MIN_COMPACTION_DELETED || num_deleted < config_->compaction_threshold * hnsw->cur_element_count) {
+        return;
+    }
+    if (compaction_.joinable()) { // The previous one is done, it clears `compacting_` last
+        compaction_.join();
+    }
+
+    // Copy the live elements, so that the graph can be built without holding the lock
+    std::vector<hnswlib::labeltype> labels;
+    std::vector<char> data;
+    labels.reserve(hnsw->cur_element_count - num_deleted);
+    data.reserve((hnsw->cur_element_count - num_deleted) * hnsw->data_size_);
+    for (hnswlib::tableint i = 0; i < hnsw->cur_element_count; i++) {
+        if (hnsw->isMarkedDeleted(i)) {
+            continue;
+        }
+        labels.push_back(hnsw->getExternalLabel(i));
+        const char* element = hnsw->getDataByInternalId(i);
+        data.insert(data.end(), element, element + hnsw->data_size_);
+    }
+
+    compacting_ = true;
+    dirty_.clear();
+    logger->info("Compacting vector store: " + std::to_string(num_deleted) + " of " + std::to_string(hnsw->cur_element_count) + " elements are deleted");
+    compaction_ = std::thread(&HNSWLibVectorStore::_compact, this, index_generation_, space, hnsw->max_elements_, !mmap_alternate_,
+                              std::move(labels), std::move(data));
+}
+
+void HNSWLibVectorStore::_compact(size_t generation, std::shared_ptr<hnswlib::SpaceInterface<float>> index_space, size_t capacity, bool alternate,
+                                  std::vector<hnswlib::labeltype> labels, std::vector<char> data) {
+    auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<hnswlib::HierarchicalNSW<float>> index;
+    try {
+        index = _new_hnsw(index_space.get(), capacity, alternate);
+        size_t data_size = index_space->get_data_size();
+        pool_.run(labels.size(), [&](size_t i) {
+            index->addPoint(data.data() + i * data_size, labels[i]);
+        });
+    } catch (const std::exception& e) {
+        logger->warn("Vector store compaction failed: " + std::string(e.what()));
+        index.reset();
+    }
+
+    auto lock = _write_lock();
+    compacting_ = false;
+    if (!index || generation != index_generation_) { // Failed, or the store has been reset meanwhile
+        dirty_.clear();
+        return;
+    }
+
+    try {
+        if (index->max_elements_ < hnsw->max_elements_) {
+            _resize_hnsw(*index, hnsw->max_elements_);
+        }
+        for (auto vector_id : dirty_) { // Bring over what changed during the rebuild
+            auto it = hnsw->label_lookup_.find(vector_id);
+            if (it != hnsw->label_lookup_.end() && !hnsw->isMarkedDeleted(it->second)) {
+                index->addPoint(hnsw->getDataByInternalId(it->second), vector_id, prepare_add(*index, vector_id));
+                continue;
+            }
+            auto new_it = index->label_lookup_.find(vector_id);
+            if (new_it != index->label_lookup_.end() && !index->isMarkedDeleted(new_it->second)) {
+                index->markDelete(vector_id);
+            }
+        }
+    } catch (const std::exception& e) {
+        logger->warn("Vector store compaction failed: " + std::string(e.what()));
+        dirty_.clear();
+        return;
+    }
+    dirty_.clear();
+
+    size_t num_removed = hnsw->cur_element_count - index->cur_element_count;
+    hnsw = index;
+    mmap_alternate_ = alternate;
+    index_generation_++;
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    logger->info("Compacted vector store: " + std::to_string(num_removed) + " deleted elements dropped in " + std::to_string(elapsed) + "ms");
+}
+
+void HNSWLibVectorStore::_remove(size_t vector_id) {
+    _index_remove(vector_id);
+    auto it = slot_of_.find(vector_id);
+    if (it != slot_of_.end()) {
+        uint32_t slot = it->second;
+        tenant_count_[tenant_[slot]]--;
+        for (auto tag : tags_[slot]) {
+            tag_count_[tag]--;
+        }
+        if (--hash_count_[hash_[slot]] == 0) {
+            hash_count_.erase(hash_[slot]);
+        }
+        live_[slot] = 0;
+        tags_[slot].clear();
+        std::string().swap(memory_[slot]);
+        hash_[slot].clear();
+        free_slots_.push_back(slot);
+        slot_of_.erase(it);
+    }
+    version_++;
+}
+
+void HNSWLibVectorStore::update(size_t vector_id, const std::vector<float>& vector, const MemoryItem& metadata) {
+    auto lock = _write_lock();
+
+    MemoryItem new_metadata;
     if (!metadata.empty()) {
-        MemoryItem new_metadata = metadata;
+        new_metadata = metadata;
         new_metadata.id = vector_id; // Make sure the id is the same as the vector id
         auto now = std::chrono::system_clock::now().time_since_epoch().count();
-        if (cache_map.find(vector_id) != cache_map.end()) {
-            MemoryItem old_metadata = *cache_map[vector_id];
-            if (new_metadata.hash == old_metadata.hash) {
-                new_metadata.created_at = old_metadata.created_at;
+        auto it = slot_of_.find(vector_id);
+        if (it != slot_of_.end()) {
+            if (new_metadata.hash == hash_[it->second]) {
+                new_metadata.created_at = created_at_[it->second];
             } else {
                 new_metadata.created_at = now;
             }
@@ -97,54 +838,513 @@ void HNSWLibVectorStore::update(size_t vector_id, const std::vector<float>& vect
             new_metadata.created_at = now;
         }
         new_metadata.updated_at = now;
-        set(vector_id, new_metadata);
     }
+
+    const std::vector<float>* vector_ptr = vector.empty() ? nullptr : &vector;
+    const MemoryItem* metadata_ptr = metadata.empty() ? nullptr : &new_metadata;
+    _apply(WalOp::UPDATE, vector_id, vector_ptr, metadata_ptr);
+    _log(WalOp::UPDATE, vector_id, vector_ptr, metadata_ptr);
+
+    lock.unlock();
+    _snapshot_if_due();
 }
 
 MemoryItem HNSWLibVectorStore::get(size_t vector_id) {
-    auto it = cache_map.find(vector_id);
-    if (it != cache_map.end()) {
-        metadata_list.splice(metadata_list.begin(), metadata_list, it->second);
-        return *it->second;
+    auto lock = _read_lock();
+    int64_t slot = _find(vector_id);
+    if (slot >= 0) {
+        return _materialize(slot);
     }
     throw std::out_of_range("Vector id " + std::to_string(vector_id) + " not found in cache");
 }
 
+int64_t HNSWLibVectorStore::_find(size_t vector_id) const {
+    auto it = slot_of_.find(vector_id);
+    if (it == slot_of_.end()) {
+        return -1;
+    }
+    referenced_[it->second].store(true, std::memory_order_relaxed);
+    return it->second;
+}
+
+MemoryItem HNSWLibVectorStore::_materialize(uint32_t slot) const {
+    MemoryItem item;
+    item.id = ids_[slot];
+    item.memory = memory_[slot];
+    item.hash = hash_[slot];
+    item.created_at = created_at_[slot];
+    item.updated_at = updated_at_[slot];
+    item.tenant = interned_[tenant_[slot]];
+    item.tags.reserve(tags_[slot].size());
+    for (auto tag : tags_[slot]) {
+        item.tags.push_back(interned_[tag]);
+    }
+    return item;
+}
+
+int64_t HNSWLibVectorStore::_lookup(const std::string& str) const {
+    auto it = intern_ids_.find(str);
+    return it == intern_ids_.end() ? -1 : static_cast<int64_t>(it->second);
+}
+
+uint32_t HNSWLibVectorStore::_intern(const std::string& str) {
+    auto [it, inserted] = intern_ids_.emplace(str, static_cast<uint32_t>(interned_.size()));
+    if (inserted) {
+        interned_.push_back(str);
+        tenant_count_.push_back(0);
+        tag_count_.push_back(0);
+    }
+    return it->second;
+}
+
 void HNSWLibVectorStore::set(size_t vector_id, const MemoryItem& metadata) {
-    auto it = cache_map.find(vector_id);
-    if (it != cache_map.end()) { // update existing metadata
-        *it->second = metadata;
-        metadata_list.splice(metadata_list.begin(), metadata_list, it->second);
+    auto lock = _write_lock();
+    _set(vector_id, metadata);
+    _log(WalOp::SET, vector_id, nullptr, &metadata);
+
+    lock.unlock();
+    _snapshot_if_due();
+}
+
+void HNSWLibVectorStore::_set(size_t vector_id, const MemoryItem& metadata) {
+    auto it = slot_of_.find(vector_id);
+    uint32_t slot;
+    if (it != slot_of_.end()) { // update existing metadata
+        slot = it->second;
+        tenant_count_[tenant_[slot]]--;
+        for (auto tag : tags_[slot]) {
+            tag_count_[tag]--;
+        }
+        if (--hash_count_[hash_[slot]] == 0) {
+            hash_count_.erase(hash_[slot]);
+        }
     } else { // insert new metadata
-        if (cache_map.size() >= config_->max_elements) { // cache full
-            auto last = metadata_list.back();
-            cache_map.erase(last.id);
-            metadata_list.pop_back();
+        if (free_slots_.empty()) { // cache full
+            _evict();
+        }
+        slot = free_slots_.back();
+        free_slots_.pop_back();
+        slot_of_[vector_id] = slot;
+    }
+
+    ids_[slot] = vector_id;
+    memory_[slot] = metadata.memory;
+    hash_[slot] = metadata.hash;
+    created_at_[slot] = metadata.created_at;
+    updated_at_[slot] = metadata.updated_at;
+    tenant_[slot] = _intern(metadata.tenant);
+    tags_[slot].clear();
+    for (const auto& tag : metadata.tags) {
+        tags_[slot].push_back(_intern(tag));
+    }
+    std::sort(tags_[slot].begin(), tags_[slot].end());
+    tags_[slot].erase(std::unique(tags_[slot].begin(), tags_[slot].end()), tags_[slot].end());
+    tenant_count_[tenant_[slot]]++;
+    for (auto tag : tags_[slot]) {
+        tag_count_[tag]++;
+    }
+    hash_count_[hash_[slot]]++;
+    live_[slot] = 1;
+    referenced_[slot].store(true, std::memory_order_relaxed); // Recently written
+    version_++;
+}
+
+bool HNSWLibVectorStore::_evict(const std::unordered_set<size_t>* pinned) {
+    for (size_t step = 0; step < 2 * live_.size(); step++) { // The first sweep clears all reference bits
+        size_t slot = clock_hand_;
+        clock_hand_ = (clock_hand_ + 1) % live_.size();
+        if (!live_[slot] || (pinned && pinned->count(ids_[slot]) > 0) || referenced_[slot].exchange(false, std::memory_order_relaxed)) {
+            continue;
+        }
+        size_t vector_id = ids_[slot];
+        _remove(vector_id);
+        _log(WalOp::REMOVE, vector_id, nullptr, nullptr); // Eviction depends on reads, so it is logged explicitly
+        return true;
+    }
+    return false;
+}
+
+void HNSWLibVectorStore::_apply(WalOp op, size_t vector_id, const std::vector<float>* vector, const MemoryItem* metadata) {
+    std::vector<float> normalized;
+    std::vector<char> buffer;
+    const float* data = vector ? _prepare(*vector, normalized) : nullptr;
+    switch (op) {
+        case WalOp::INSERT:
+            if (slot_of_.size() >= live_.size() && slot_of_.find(vector_id) == slot_of_.end()) {
+                // Only when replaying records logged after the store grew past its snapshot, `_reserve` makes room otherwise
+                _resize(live_.size() * 2);
+            }
+            _index_add(_encode(data, buffer), vector_id);
+            _set(vector_id, *metadata);
+            if (_rerank()) {
+                _set_vector(vector_id, data);
+            }
+            break;
+        case WalOp::UPDATE:
+            if (vector) {
+                if (!metadata && slot_of_.find(vector_id) == slot_of_.end()) {
+                    throw std::out_of_range("Vector id " + std::to_string(vector_id) + " not found");
+                }
+                _index_add(_encode(data, buffer), vector_id); // Updated in place
+            }
+            if (metadata) {
+                _set(vector_id, *metadata);
+            }
+            if (vector && _rerank()) {
+                _set_vector(vector_id, data);
+            }
+            version_++;
+            break;
+        case WalOp::SET:
+            _set(vector_id, *metadata);
+            break;
+        case WalOp::REMOVE:
+            _remove(vector_id);
+            break;
+    }
+}
+
+// Record layout: payload size (u32), FNV-1a checksum of the payload (u32), payload:
+// seq (u64), op (u8), vector id (u64), vector dim (u32) + floats, has metadata (u8) + item
+void HNSWLibVectorStore::_log(WalOp op, size_t vector_id, const std::vector<float>* vector, const MemoryItem* metadata) {
+    if (!wal_) {
+        return;
+    }
+
+    std::string payload;
+    put<uint64_t>(payload, ++seq_);
+    put<uint8_t>(payload, static_cast<uint8_t>(op));
+    put<uint64_t>(payload, vector_id);
+    put<uint32_t>(payload, vector ? vector->size() : 0);
+    if (vector) {
+        payload.append(reinterpret_cast<const char*>(vector->data()), vector->size() * sizeof(float));
+    }
+    put<uint8_t>(payload, metadata ? 1 : 0);
+    if (metadata) {
+        put_memory_item(payload, *metadata);
+    }
+
+    std::string record;
+    put<uint32_t>(record, payload.size());
+    put<uint32_t>(record, fnv1a(payload.data(), payload.size()));
+    record += payload;
+
+    wal_->write(record.data(), record.size());
+    wal_->flush();
+    if (!*wal_) {
+        throw std::runtime_error("Failed to write vector store log in " + config_->path);
+    }
+
+    if (++ops_since_snapshot_ >= static_cast<size_t>(std::max(config_->snapshot_interval, 1))) {
+        snapshot_due_ = true; // Taken by the caller once the exclusive lock is released
+    }
+}
+
+void HNSWLibVectorStore::_snapshot_if_due() {
+    std::unique_lock<std::mutex> snapshot_lock(snapshot_mutex_, std::try_to_lock);
+    if (!snapshot_lock) { // Another thread is taking one
+        return;
+    }
+    auto lock = _read_lock();
+    if (snapshot_due_) {
+        _snapshot();
+    }
+}
+
+// Layout of <path>:
+//   CURRENT          sequence number of the latest complete snapshot (replaced atomically, the files of a new
+//                    snapshot never overwrite those of the one it refers to)
+//   <seq>.index      hnswlib index (HNSW graph or flat)
+//   <seq>.meta       metadata of all live vectors
+//   wal.log          operations after the snapshot
+void HNSWLibVectorStore::_snapshot() {
+    namespace fs = std::filesystem;
+    fs::path dir(config_->path);
+    fs::create_directories(dir);
+
+    std::string old_seq_str;
+    if (fs::exists(dir / "CURRENT")) {
+        old_seq_str = read_file(dir / "CURRENT");
+    }
+    if (old_seq_str == std::to_string(seq_)) {
+        // Nothing logged since the last snapshot (e.g. after `reset`), never overwrite the files CURRENT refers to.
+        // The log is truncated below, so no record has the skipped sequence number.
+        seq_++;
+    }
+    std::string seq_str = std::to_string(seq_);
+
+    if (flat) {
+        flat->saveIndex((dir / (seq_str + ".index")).string());
+    } else {
+        hnsw->saveIndex((dir / (seq_str + ".index")).string());
+    }
+
+    std::string meta;
+    put<uint32_t>(meta, METADATA_MAGIC);
+    put<uint32_t>(meta, METADATA_VERSION);
+    put<uint64_t>(meta, seq_);
+    put<uint32_t>(meta, config_->dim);
+    put<uint32_t>(meta, static_cast<uint32_t>(config_->metric));
+    put<uint32_t>(meta, static_cast<uint32_t>(config_->quantization));
+    put<uint32_t>(meta, _rerank() ? config_->dim : 0); // Full precision floats after each item
+    put<uint32_t>(meta, flat ? INDEX_FLAT : INDEX_HNSW);
+    put<uint64_t>(meta, slot_of_.size());
+    for (const auto& [vector_id, slot] : slot_of_) {
+        put_memory_item(meta, _materialize(slot));
+        if (_rerank()) {
+            meta.append(reinterpret_cast<const char*>(vectors_.data() + static_cast<size_t>(slot) * config_->dim), config_->dim * sizeof(float));
+        }
+    }
+    {
+        std::ofstream file(dir / (seq_str + ".meta"), std::ios::binary | std::ios::trunc);
+        file.write(meta.data(), meta.size());
+        if (!file) {
+            throw std::runtime_error("Failed to write vector store snapshot in " + config_->path);
         }
+    }
+    {
+        std::ofstream file(dir / "CURRENT.tmp", std::ios::binary | std::ios::trunc);
+        file << seq_str;
+    }
+    fs::rename(dir / "CURRENT.tmp", dir / "CURRENT");
 
-        metadata_list.emplace_front(metadata);
-        cache_map[vector_id] = metadata_list.begin();
+    // Operations up to `seq_` are in the snapshot now
+    wal_ = std::make_unique<std::ofstream>(dir / "wal.log", std::ios::binary | std::ios::trunc);
+    ops_since_snapshot_ = 0;
+    snapshot_due_ = false;
+
+    if (!old_seq_str.empty() && old_seq_str != seq_str) {
+        std::error_code ec;
+        fs::remove(dir / (old_seq_str + ".index"), ec);
+        fs::remove(dir / (old_seq_str + ".meta"), ec);
     }
 }
 
+void HNSWLibVectorStore::_load() {
+    namespace fs = std::filesystem;
+    fs::path dir(config_->path);
+    fs::create_directories(dir);
+
+    if (fs::exists(dir / "CURRENT")) {
+        std::string seq_str = read_file(dir / "CURRENT");
+        MappedFile meta((dir / (seq_str + ".meta")).string());
+        Reader reader{meta.data(), meta.data() + meta.size()};
+        auto magic = reader.get<uint32_t>();
+        auto version = reader.get<uint32_t>();
+        if (magic != METADATA_MAGIC || version < 1 || version > METADATA_VERSION) {
+            throw std::runtime_error("Invalid vector store snapshot in " + config_->path);
+        }
+        seq_ = reader.get<uint64_t>();
+        auto dim = reader.get<uint32_t>();
+        auto metric = reader.get<uint32_t>();
+        uint32_t quantization = static_cast<uint32_t>(VectorStoreConfig::Quantization::NONE);
+        uint32_t vector_dim = 0;
+        if (version >= 2) {
+            quantization = reader.get<uint32_t>();
+            vector_dim = reader.get<uint32_t>();
+        }
+        uint32_t index_kind = version >= 3 ? reader.get<uint32_t>() : INDEX_HNSW;
+        if (dim != static_cast<uint32_t>(config_->dim) || metric != static_cast<uint32_t>(config_->metric)
+            || quantization != static_cast<uint32_t>(config_->quantization)) {
+            throw std::runtime_error("Vector store snapshot in " + config_->path + " was written with a different dim, metric or quantization");
+        }
+        if (!_auto() && index_kind != (flat ? INDEX_FLAT : INDEX_HNSW)) {
+            throw std::runtime_error("Vector store snapshot in " + config_->path + " was written by a different provider");
+        }
+
+        MappedFile index_file((dir / (seq_str + ".index")).string());
+        MappedFileStream index(index_file);
+        hnsw.reset(); // Release the mapping of the empty index first
+        flat.reset();
+        index_generation_++;
+        if (index_kind == INDEX_FLAT) {
+            flat = std::make_shared<hnswlib::BruteforceSearch<float>>(space.get(), index, config_->max_elements);
+            if (_auto() && flat->cur_element_count > static_cast<size_t>(std::max(config_->auto_threshold, 0))) {
+                _build_hnsw();
+            }
+        } else if (_mmap()) {
+            hnsw = std::make_shared<MMapHierarchicalNSW>(space.get(), _mmap_file(mmap_alternate_), index, config_->max_elements, true);
+        } else {
+            hnsw = std::make_shared<hnswlib::HierarchicalNSW<float>>(space.get(), index, config_->max_elements, true);
+        }
+        _resize(flat ? flat->maxelements_ : hnsw->max_elements_); // Grown beyond `max_elements` before
+
+        auto count = reader.get<uint64_t>();
+        std::vector<float> vector(config_->dim);
+        for (uint64_t i = 0; i < count; i++) {
+            auto item = reader.get_memory_item();
+            _set(item.id, item);
+            for (uint32_t j = 0; j < vector_dim; j++) {
+                vector[j] = reader.get<float>();
+            }
+            if (!_rerank()) {
+                continue;
+            }
+            if (vector_dim == 0) { // Re-ranking was just enabled, the dequantized vectors are the best we have
+                _decode(flat ? flat->getDataPointerByLabel(item.id) : hnsw->getDataByLabel<char>(item.id).data(), vector.data());
+            }
+            _set_vector(item.id, vector.data());
+        }
+    }
+
+    // Replay operations after the snapshot, stopping at the first torn or corrupted record
+    size_t num_replayed = 0;
+    size_t valid_size = 0;
+    size_t wal_size = 0;
+    if (fs::exists(dir / "wal.log")) {
+        MappedFile wal((dir / "wal.log").string());
+        wal_size = wal.size();
+        Reader reader{wal.data(), wal.data() + wal.size()};
+        try {
+            while (reader.pos < reader.end) {
+                auto size = reader.get<uint32_t>();
+                auto checksum = reader.get<uint32_t>();
+                if (reader.end - reader.pos < static_cast<ptrdiff_t>(size)) {
+                    break;
+                }
+                if (fnv1a(reader.pos, size) != checksum) {
+                    break;
+                }
+                Reader record{reader.pos, reader.pos + size};
+                reader.pos += size;
+
+                auto seq = record.get<uint64_t>();
+                auto op = static_cast<WalOp>(record.get<uint8_t>());
+                auto vector_id = record.get<uint64_t>();
+                std::vector<float> vector(record.get<uint32_t>());
+                for (auto& value : vector) {
+                    value = record.get<float>();
+                }
+                std::optional<MemoryItem> metadata;
+                if (record.get<uint8_t>()) {
+                    metadata = record.get_memory_item();
+                }
+
+                valid_size = reader.pos - wal.data();
+                if (seq <= seq_) { // Already in the snapshot
+                    continue;
+                }
+                try {
+                    _apply(op, vector_id, vector.empty() ? nullptr : &vector, metadata ? &*metadata : nullptr);
+                } catch (const std::exception& e) {
+                    logger->warn("Skipping vector store log record " + std::to_string(seq) + ": " + e.what());
+                }
+                seq_ = seq;
+                num_replayed++;
+            }
+        } catch (const std::exception& /* e */) {
+            // Torn header at the end of the log
+        }
+    }
+    if (valid_size < wal_size) { // Unmapped by now
+        logger->warn("Truncating " + std::to_string(wal_size - valid_size) + " trailing bytes of " + (dir / "wal.log").string());
+        fs::resize_file(dir / "wal.log", valid_size);
+    }
+
+    wal_ = std::make_unique<std::ofstream>(dir / "wal.log", std::ios::binary | std::ios::app);
+    ops_since_snapshot_ = num_replayed;
+
+    logger->info("Loaded " + std::to_string(slot_of_.size()) + " memories from " + config_->path + " (" + std::to_string(num_replayed) + " replayed)");
+}
+
 std::vector<MemoryItem> HNSWLibVectorStore::list(size_t limit, const FilterFunc& filter) {
+    auto lock = _read_lock();
+
     std::vector<MemoryItem> result;
-    size_t count = hnsw->cur_element_count;
-    
+    size_t count = flat ? flat->cur_element_count : hnsw->cur_element_count.load();
+
     for (size_t i = 0; i < count; i++) {
-        if (!hnsw->isMarkedDeleted(i)) {
-            auto memory_item = get(i);
+        if (flat || !hnsw->isMarkedDeleted(i)) {
+            hnswlib::labeltype label;
+            if (flat) {
+                std::memcpy(&label, flat->data_ + flat->size_per_element_ * i + flat->data_size_, sizeof(label));
+            } else {
+                label = hnsw->getExternalLabel(i);
+            }
+            int64_t slot = _find(label);
+            if (slot < 0) {
+                continue;
+            }
+            auto memory_item = _materialize(slot);
             if (filter && !filter(memory_item)) {
                 continue;
             }
-            result.emplace_back(memory_item);
+            result.emplace_back(std::move(memory_item));
             if (limit > 0 && result.size() >= limit) {
                 break;
             }
         }
     }
-    
+
     return result;
 }
 
+bool HNSWLibVectorStore::contains_hash(const std::string& hash) {
+    auto lock = _read_lock();
+    return hash_count_.find(hash) != hash_count_.end();
+}
+
+HNSWLibMemoryFilterFunctor::HNSWLibMemoryFilterFunctor(const HNSWLibVectorStore& store, const MemoryFilter& filter)
+    : HNSWLibSlotFilterFunctor(store), filter(filter) {
+    if (filter.tenant) {
+        tenant = store._lookup(*filter.tenant);
+        satisfiable = tenant >= 0;
+    }
+    if (!filter.tags.empty()) {
+        for (const auto& tag : filter.tags) {
+            int64_t id = store._lookup(tag);
+            if (id > 0) {
+                tags.push_back(static_cast<uint32_t>(id));
+            }
+        }
+        std::sort(tags.begin(), tags.end());
+        satisfiable = satisfiable && !tags.empty();
+    }
+}
+
+bool HNSWLibMemoryFilterFunctor::allows(uint32_t slot) const {
+    long long created_at = vector_store.created_at_[slot];
+    long long updated_at = vector_store.updated_at_[slot];
+    if (created_at < filter.created_after || created_at > filter.created_before
+        || updated_at < filter.updated_after || updated_at > filter.updated_before) {
+        return false;
+    }
+    if (tenant >= 0 && vector_store.tenant_[slot] != tenant) {
+        return false;
+    }
+    if (!tags.empty()) { // Both sorted, intersect
+        const auto& item_tags = vector_store.tags_[slot];
+        auto a = tags.begin();
+        auto b = item_tags.begin();
+        while (a != tags.end() && b != item_tags.end()) {
+            if (*a == *b) {
+                return true;
+            }
+            *a < *b ? ++a : ++b;
+        }
+        return false;
+    }
+    return true;
+}
+
+std::pair<size_t, bool> HNSWLibMemoryFilterFunctor::bound() const {
+    bool time_range = filter.created_after != std::numeric_limits<long long>::min()
+        || filter.created_before != std::numeric_limits<long long>::max()
+        || filter.updated_after != std::numeric_limits<long long>::min()
+        || filter.updated_before != std::numeric_limits<long long>::max();
+
+    size_t bound = vector_store.slot_of_.size();
+    if (tenant >= 0) {
+        bound = std::min<size_t>(bound, vector_store.tenant_count_[tenant]);
+    }
+    if (!tags.empty()) {
+        size_t tag_bound = 0; // Memories with several of the tags are counted repeatedly
+        for (auto tag : tags) {
+            tag_bound += vector_store.tag_count_[tag];
+        }
+        bound = std::min(bound, tag_bound);
+    }
+    return {bound, !time_range && (tenant < 0 || tags.empty()) && tags.size() <= 1};
+}
+
 };
@@ -3,27 +3,303 @@
 
 #include "base.h"
 #include "hnswlib/hnswlib.h"
-#include <list>
+#include "../worker_pool.h"
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_set>
 
 namespace humanus {
 
+class HNSWLibSlotFilterFunctor;
+
+// Shared mutex on which new readers block while a writer waits, so that a steady stream of searches cannot
+// starve modifications. Usable with std::shared_lock / std::unique_lock, not recursive.
+class WriterPreferringSharedMutex {
+private:
+    std::mutex mutex_;
+    std::condition_variable readers_cv_;
+    std::condition_variable writers_cv_;
+    size_t readers_ = 0;
+    size_t waiting_writers_ = 0;
+    bool writer_ = false;
+
+public:
+    void lock() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        waiting_writers_++;
+        writers_cv_.wait(lock, [this] { return !writer_ && readers_ == 0; });
+        waiting_writers_--;
+        writer_ = true;
+    }
+
+    void unlock() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            writer_ = false;
+        }
+        writers_cv_.notify_one();
+        readers_cv_.notify_all();
+    }
+
+    void lock_shared() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        readers_cv_.wait(lock, [this] { return !writer_ && waiting_writers_ == 0; });
+        readers_++;
+    }
+
+    void unlock_shared() {
+        bool notify;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            notify = --readers_ == 0 && waiting_writers_ > 0;
+        }
+        if (notify) {
+            writers_cv_.notify_one();
+        }
+    }
+};
+
+// Concurrent searches (and gets) run under a shared lock, modifications under an exclusive one.
+// Metadata is stored column-wise in slots so that filters can be evaluated without materializing
+// `MemoryItem`s. Readers never reorder anything: they only set a reference bit, and eviction sweeps
+// the slots giving referenced ones a second chance (CLOCK approximation of LRU).
+// If `path` is configured, every modification is appended to a write-ahead log and the store is
+// periodically snapshotted (index + metadata), both are loaded on construction.
+// The "hnswlib_mmap" provider additionally keeps the bulk of the index in a memory-mapped file under `path`
+// (see `MMapHierarchicalNSW`), so large stores are paged in on demand instead of occupying the heap.
+// With `quantization` the index holds fp16 / int8 vectors, optionally re-ranked with full precision copies.
+// The "bruteforce" provider scans all vectors exactly instead, "auto" does so until the store outgrows
+// `auto_threshold` and then builds the HNSW graph.
+// The capacity starts at `max_elements` and doubles while the index fits into `memory_budget_mb`, beyond that
+// the least recently used memories are evicted. New vectors take the place of deleted ones in the graph, and
+// once too many deleted ones pile up the graph is rebuilt in the background without them.
+// Graph searches use a candidate list of `ef_search` (or per query `ef`). With `recall_target`, every
+// `recall_sample_interval`-th search is repeated exactly and `ef_search` is adjusted to the smallest value
+// that keeps the sampled recall at the target.
+// Filtered searches estimate how many memories match. Small subsets are scanned exactly instead of walking
+// (and rejecting) most of the graph, larger ones are searched with `ef` widened by the inverse selectivity.
 class HNSWLibVectorStore : public VectorStore {
 private:
+    enum class WalOp : uint8_t {
+        INSERT = 1,
+        UPDATE = 2,
+        SET = 3,
+        REMOVE = 4
+    };
+
     std::shared_ptr<hnswlib::HierarchicalNSW<float>> hnsw;
+    std::shared_ptr<hnswlib::BruteforceSearch<float>> flat; // Used instead of `hnsw` while scanning exhaustively
     std::shared_ptr<hnswlib::SpaceInterface<float>> space;
-    std::unordered_map<size_t, std::list<MemoryItem>::iterator> cache_map; // LRU cache
-    std::list<MemoryItem> metadata_list; // Metadata for stored vectors
+    std::shared_ptr<hnswlib::SpaceInterface<float>> full_space; // Full precision distance for re-ranking
+
+    // Metadata columns, indexed by slot
+    std::unordered_map<size_t, uint32_t> slot_of_;   // vector id -> slot
+    std::vector<size_t> ids_;
+    std::vector<long long> created_at_;
+    std::vector<long long> updated_at_;
+    std::vector<uint32_t> tenant_;                   // Interned, 0 for none
+    std::vector<std::vector<uint32_t>> tags_;        // Interned, sorted
+    std::vector<std::string> memory_;
+    std::vector<std::string> hash_;
+    std::vector<uint8_t> live_;
+    std::vector<float> vectors_;                     // Full precision copies (`dim` per slot) if re-ranking
+    std::unique_ptr<std::atomic<bool>[]> referenced_;
+    std::vector<uint32_t> free_slots_;
+    size_t clock_hand_ = 0;
+
+    // Live slots per interned tenant / tag, bounds the selectivity of filters
+    std::vector<uint32_t> tenant_count_;
+    std::vector<uint32_t> tag_count_;
+
+    // Live slots per content hash, for exact duplicate checks
+    std::unordered_map<std::string, uint32_t> hash_count_;
+
+    // Interned tenants and tags, id 0 is the empty string
+    std::unordered_map<std::string, uint32_t> intern_ids_;
+    std::vector<std::string> interned_;
+
+    mutable WriterPreferringSharedMutex mutex_;
+
+    std::shared_lock<WriterPreferringSharedMutex> _read_lock() const {
+        return std::shared_lock<WriterPreferringSharedMutex>(mutex_);
+    }
+
+    std::unique_lock<WriterPreferringSharedMutex> _write_lock() {
+        return std::unique_lock<WriterPreferringSharedMutex>(mutex_);
+    }
+
+    // Threads of batch inserts / searches and compaction, started with the store
+    WorkerPool pool_;
+
+    // Background compaction, guarded by `mutex_` like the index
+    std::thread compaction_;
+    bool compacting_ = false;
+    std::unordered_set<size_t> dirty_;  // Vector ids modified while compacting
+    size_t index_generation_ = 0;       // Bumped whenever the index is replaced
+    bool mmap_alternate_ = false;       // Which of the two mapped files holds the index, compaction builds in the other
+
+    // Candidate list size of graph searches, tuned towards `recall_target`
+    mutable std::atomic<size_t> ef_search_{0};
+    mutable std::atomic<size_t> searches_{0};
+    mutable std::mutex tuner_mutex_;
+    mutable size_t tuner_samples_ = 0;  // Sampled searches (and their exact / found results) since `ef_search_` changed
+    mutable size_t tuner_relevant_ = 0;
+    mutable size_t tuner_found_ = 0;
+
+    // Persistence
+    std::unique_ptr<std::ofstream> wal_;
+    uint64_t seq_ = 0;                  // Sequence number of the last logged operation
+    size_t ops_since_snapshot_ = 0;
+    bool snapshot_due_ = false;         // Set by `_log` every `snapshot_interval` operations
+    std::mutex snapshot_mutex_;         // Held while taking a snapshot under the shared lock
+
+    friend class HNSWLibSlotFilterFunctor;
+    friend class HNSWLibFilterFunctorWrapper;
+    friend class HNSWLibMemoryFilterFunctor;
+
+    // Slot of `vector_id` or -1, marks it as recently used. Requires (at least) a shared lock.
+    int64_t _find(size_t vector_id) const;
+
+    MemoryItem _materialize(uint32_t slot) const;
+
+    // Interned id of `str`, or -1 if it has never been stored. Requires (at least) a shared lock.
+    int64_t _lookup(const std::string& str) const;
+
+    std::vector<MemoryItem> _search(const std::vector<float>& query, size_t limit, HNSWLibSlotFilterFunctor* filter, size_t ef) const;
+
+    // Compare `results` of a graph search to the exact ones and adjust `ef_search_` towards `recall_target`
+    void _tune(const void* query, size_t k, std::priority_queue<std::pair<float, hnswlib::labeltype>> results) const;
+
+    // Estimated number of live memories `filter` allows, from tenant / tag counts and a sample of the slots
+    size_t _estimate(const HNSWLibSlotFilterFunctor& filter) const;
+
+    // Exact search over the slots `filter` allows, all of them if null (graph index only)
+    std::priority_queue<std::pair<float, hnswlib::labeltype>> _scan(const void* query, size_t k, const HNSWLibSlotFilterFunctor* filter) const;
+
+    // Quantized candidates are re-ranked at full precision
+    bool _rerank() const {
+        return config_->quantization != VectorStoreConfig::Quantization::NONE && config_->rerank_factor > 0;
+    }
+
+    // `vector` as indexed: normalized (into `normalized`) for the cosine metric. Checks the dimension.
+    const float* _prepare(const std::vector<float>& vector, std::vector<float>& normalized) const;
+
+    // Prepared `vector` in the element format of `space`, `buffer` holds it if it has to be converted
+    const void* _encode(const float* vector, std::vector<char>& buffer) const;
+
+    void _decode(const void* data, float* vector) const;
+
+    // Level 0 of the index lives in a memory-mapped file (provider "hnswlib_mmap")
+    bool _mmap() const {
+        return config_->provider == "hnswlib_mmap";
+    }
+
+    std::string _mmap_file(bool alternate) const {
+        return (std::filesystem::path(config_->path) / (alternate ? "level0.alt.mmap" : "level0.mmap")).string();
+    }
+
+    // Empty graph that reuses the places of deleted elements
+    std::shared_ptr<hnswlib::HierarchicalNSW<float>> _new_hnsw(hnswlib::SpaceInterface<float>* s, size_t capacity, bool alternate) const;
+
+    void _resize_hnsw(hnswlib::HierarchicalNSW<float>& index, size_t capacity) const;
+
+    // Estimated heap size of one element (index and metadata columns, without the memory text)
+    size_t _bytes_per_element() const;
+
+    // Exact scan while small, HNSW beyond `auto_threshold` (provider "auto")
+    bool _auto() const {
+        return config_->provider == "auto";
+    }
+
+    // Prepared and encoded `data` is indexed as `vector_id`, replacing a previous vector
+    void _index_add(const void* data, size_t vector_id);
+
+    void _index_remove(size_t vector_id);
+
+    std::priority_queue<std::pair<float, hnswlib::labeltype>> _index_search(const void* query, size_t k, hnswlib::BaseFilterFunctor* filter, size_t ef) const;
+
+    // Move all vectors from `flat` into a new HNSW graph
+    void _build_hnsw();
+
+    // Grow the index and the metadata columns to `capacity` elements
+    void _resize(size_t capacity);
+
+    // Make room for `num_new` more memories: grow within the memory budget, evict beyond it (but not the `pinned` ids)
+    void _reserve(size_t num_new, const std::unordered_set<size_t>* pinned = nullptr);
+
+    // Start rebuilding the graph if enough of it is deleted
+    void _schedule_compaction();
+
+    // Runs in `compaction_`: build a graph of `labels` / `data` (copied when scheduled) and swap it in
+    void _compact(size_t generation, std::shared_ptr<hnswlib::SpaceInterface<float>> index_space, size_t capacity, bool alternate,
+                  std::vector<hnswlib::labeltype> labels, std::vector<char> data);
+
+    // The following require an exclusive lock
+    void _reset();
+
+    // Apply an operation exactly as logged (`vector` and `metadata` may be null if not part of it)
+    void _apply(WalOp op, size_t vector_id, const std::vector<float>* vector, const MemoryItem* metadata);
+
+    void _log(WalOp op, size_t vector_id, const std::vector<float>* vector, const MemoryItem* metadata);
+
+    // Load the latest snapshot and replay the write-ahead log
+    void _load();
+
+    // Requires (at least) a shared lock, plus `snapshot_mutex_` if not exclusive
+    void _snapshot();
+
+    // Take a snapshot if one is due. Runs after the exclusive lock of a modification is released, under a shared
+    // lock: searches go on while the index is written, writers (and thus the log) wait.
+    void _snapshot_if_due();
+
+    void _remove(size_t vector_id);
+
+    void _set(size_t vector_id, const MemoryItem& metadata);
+
+    void _set_vector(size_t vector_id, const float* vector);
+
+    // Evict the least recently used memory other than the `pinned` ones, false if there is none
+    bool _evict(const std::unordered_set<size_t>* pinned = nullptr);
+
+    uint32_t _intern(const std::string& str);
 
 public:
     HNSWLibVectorStore(const std::shared_ptr<VectorStoreConfig>& config) : VectorStore(config) {
-        reset();
+        _reset();
+        if (!config_->path.empty()) {
+            _load();
+        }
+    }
+
+    ~HNSWLibVectorStore();
+
+    bool thread_safe() const override {
+        return true;
     }
 
     void reset() override;
 
     void insert(const std::vector<float>& vector, const size_t vector_id, const MemoryItem& metadata = MemoryItem()) override;
 
-    std::vector<MemoryItem> search(const std::vector<float>& query, size_t limit, const FilterFunc& filter = nullptr) override;
+    // Vectors are added to the HNSW graph concurrently, metadata and log records are written afterwards
+    void insert_batch(const std::vector<std::vector<float>>& vectors, const std::vector<size_t>& vector_ids, const std::vector<MemoryItem>& metadatas = {}) override;
+
+    std::vector<MemoryItem> search(const std::vector<float>& query, size_t limit, const FilterFunc& filter = nullptr, size_t ef = 0) override;
+
+    std::vector<MemoryItem> search(const std::vector<float>& query, size_t limit, const MemoryFilter& filter, size_t ef = 0) override;
+
+    // Queries run concurrently under one shared lock
+    std::vector<std::vector<MemoryItem>> search_batch(const std::vector<std::vector<float>>& queries, size_t limit = 5, const FilterFunc& filter = nullptr,
+                                                      size_t ef = 0) override;
+
+    // Candidate list size of searches without a per query `ef`, as tuned towards `recall_target`
+    size_t ef_search() const {
+        return ef_search_.load(std::memory_order_relaxed);
+    }
 
     void remove(size_t vector_id) override;
 
@@ -34,30 +310,73 @@ public:
     void set(size_t vector_id, const MemoryItem& metadata) override;
 
     std::vector<MemoryItem> list(size_t limit, const FilterFunc& filter = nullptr) override;
+
+    bool contains_hash(const std::string& hash) override;
 };
 
-class HNSWLibFilterFunctorWrapper : public hnswlib::BaseFilterFunctor {
+// Evaluated during `search`, i.e. while the store is (shared) locked, possibly from several threads
+class HNSWLibSlotFilterFunctor : public hnswlib::BaseFilterFunctor {
+protected:
+    const HNSWLibVectorStore& vector_store;
+
+public:
+    HNSWLibSlotFilterFunctor(const HNSWLibVectorStore& store) : vector_store(store) {}
+
+    virtual bool allows(uint32_t slot) const = 0;
+
+    // Upper bound of the number of memories allowed, and whether it is exact
+    virtual std::pair<size_t, bool> bound() const {
+        return {vector_store.slot_of_.size(), false};
+    }
+
+    bool operator()(hnswlib::labeltype id) override {
+        auto it = vector_store.slot_of_.find(id);
+        return it != vector_store.slot_of_.end() && allows(it->second);
+    }
+};
+
+class HNSWLibFilterFunctorWrapper : public HNSWLibSlotFilterFunctor {
 private:
-    HNSWLibVectorStore& vector_store;
     FilterFunc filter_func;
 
 public:
-    HNSWLibFilterFunctorWrapper(HNSWLibVectorStore& store, const FilterFunc& filter_func)
-    : vector_store(store), filter_func(filter_func) {}
+    HNSWLibFilterFunctorWrapper(const HNSWLibVectorStore& store, const FilterFunc& filter_func)
+    : HNSWLibSlotFilterFunctor(store), filter_func(filter_func) {}
 
-    bool operator()(hnswlib::labeltype id) override {
+    bool allows(uint32_t slot) const override {
         if (filter_func == nullptr) {
             return true;
         }
-        
+
         try {
-            return filter_func(vector_store.get(id));
+            return filter_func(vector_store._materialize(slot));
         } catch (...) {
             return false;
         }
     }
 };
 
+// A `MemoryFilter` compiled against the interned columns, evaluation does not allocate
+class HNSWLibMemoryFilterFunctor : public HNSWLibSlotFilterFunctor {
+private:
+    const MemoryFilter& filter;
+    int64_t tenant = -1;            // -1 for any
+    std::vector<uint32_t> tags;     // Sorted
+    bool satisfiable = true;
+
+public:
+    HNSWLibMemoryFilterFunctor(const HNSWLibVectorStore& store, const MemoryFilter& filter);
+
+    // False if no stored memory can match (unknown tenant or tags)
+    bool is_satisfiable() const {
+        return satisfiable;
+    }
+
+    bool allows(uint32_t slot) const override;
+
+    std::pair<size_t, bool> bound() const override;
+};
+
 }
 
-#endif // HUMANUS_MEMORY_VECTOR_STORE_HNSWLIB_H
\ No newline at end of file
+#endif // HUMANUS_MEMORY_VECTOR_STORE_HNSWLIB_H
@@ -3,12 +3,15 @@
 #include <fstream>
 #include <mutex>
 #include <algorithm>
+#include <thread>
 #include <assert.h>
 
 namespace hnswlib {
 template<typename dist_t>
 class BruteforceSearch : public AlgorithmInterface<dist_t> {
  public:
+    static const size_t MIN_ELEMENTS_PER_THREAD = 16384;
+
     char *data_;
     size_t maxelements_;
     size_t cur_element_count;
@@ -32,14 +35,25 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
     }
 
 
-    BruteforceSearch(SpaceInterface<dist_t> *s, const std::string &location)
+    BruteforceSearch(SpaceInterface<dist_t> *s, const std::string &location, size_t max_elements = 0)
         : data_(nullptr),
             maxelements_(0),
             cur_element_count(0),
             size_per_element_(0),
             data_size_(0),
             dist_func_param_(nullptr) {
-        loadIndex(location, s);
+        loadIndex(location, s, max_elements);
+    }
+
+
+    BruteforceSearch(SpaceInterface<dist_t> *s, std::istream &input, size_t max_elements = 0)
+        : data_(nullptr),
+            maxelements_(0),
+            cur_element_count(0),
+            size_per_element_(0),
+            data_size_(0),
+            dist_func_param_(nullptr) {
+        loadIndex(input, s, max_elements);
     }
 
 
@@ -91,43 +105,102 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
             return;
         }
 
+        size_t cur_c = found->second;
         dict_external_to_internal.erase(found);
 
-        size_t cur_c = found->second;
-        labeltype label = *((labeltype*)(data_ + size_per_element_ * (cur_element_count-1) + data_size_));
-        dict_external_to_internal[label] = cur_c;
-        memcpy(data_ + size_per_element_ * cur_c,
-                data_ + size_per_element_ * (cur_element_count-1),
-                data_size_+sizeof(labeltype));
+        // Move the last element into the hole
+        size_t last = cur_element_count - 1;
+        if (cur_c != last) {
+            labeltype label = *((labeltype*)(data_ + size_per_element_ * last + data_size_));
+            dict_external_to_internal[label] = cur_c;
+            memcpy(data_ + size_per_element_ * cur_c,
+                    data_ + size_per_element_ * last,
+                    data_size_+sizeof(labeltype));
+        }
         cur_element_count--;
     }
 
 
+    void resizeIndex(size_t new_max_elements) {
+        if (new_max_elements < cur_element_count)
+            throw std::runtime_error("Cannot resize, max element is less than the current number of elements");
+
+        char *data_new = (char *) realloc(data_, std::max<size_t>(new_max_elements, 1) * size_per_element_);
+        if (data_new == nullptr)
+            throw std::runtime_error("Not enough memory: resizeIndex failed to allocate data");
+        data_ = data_new;
+        maxelements_ = new_max_elements;
+    }
+
+
+    const char *getDataPointerByLabel(labeltype label) const {
+        auto found = dict_external_to_internal.find(label);
+        if (found == dict_external_to_internal.end()) {
+            throw std::runtime_error("Label not found");
+        }
+        return data_ + size_per_element_ * found->second;
+    }
+
+
+    // Scan elements [begin, end) into the max-heap `topResults` of at most k elements.
+    // The filter is only consulted for elements that would make it into the heap.
+    void searchRange(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed, size_t begin, size_t end,
+                     std::priority_queue<std::pair<dist_t, labeltype >> &topResults) const {
+        dist_t lastdist = std::numeric_limits<dist_t>::max();
+        for (size_t i = begin; i < end; i++) {
+            const char *element = data_ + size_per_element_ * i;
+            dist_t dist = fstdistfunc_(query_data, element, dist_func_param_);
+            if (topResults.size() >= k && dist >= lastdist) {
+                continue;
+            }
+            labeltype label;
+            memcpy(&label, element + data_size_, sizeof(labeltype));
+            if (isIdAllowed && !(*isIdAllowed)(label)) {
+                continue;
+            }
+            topResults.emplace(dist, label);
+            if (topResults.size() > k) {
+                topResults.pop();
+            }
+            lastdist = topResults.top().first;
+        }
+    }
+
+
+    // Exact search. Large indexes are split into contiguous blocks scanned by several threads,
+    // in which case `isIdAllowed` has to be thread-safe.
     std::priority_queue<std::pair<dist_t, labeltype >>
     searchKnn(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed = nullptr) const {
-        assert(k <= cur_element_count);
         std::priority_queue<std::pair<dist_t, labeltype >> topResults;
-        if (cur_element_count == 0) return topResults;
-        for (int i = 0; i < k; i++) {
-            dist_t dist = fstdistfunc_(query_data, data_ + size_per_element_ * i, dist_func_param_);
-            labeltype label = *((labeltype*) (data_ + size_per_element_ * i + data_size_));
-            if ((!isIdAllowed) || (*isIdAllowed)(label)) {
-                topResults.emplace(dist, label);
-            }
+        if (k == 0 || cur_element_count == 0) return topResults;
+
+        size_t num_threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()),
+                                              cur_element_count / MIN_ELEMENTS_PER_THREAD);
+        if (num_threads <= 1) {
+            searchRange(query_data, k, isIdAllowed, 0, cur_element_count, topResults);
+            return topResults;
         }
-        dist_t lastdist = topResults.empty() ? std::numeric_limits<dist_t>::max() : topResults.top().first;
-        for (int i = k; i < cur_element_count; i++) {
-            dist_t dist = fstdistfunc_(query_data, data_ + size_per_element_ * i, dist_func_param_);
-            if (dist <= lastdist) {
-                labeltype label = *((labeltype *) (data_ + size_per_element_ * i + data_size_));
-                if ((!isIdAllowed) || (*isIdAllowed)(label)) {
-                    topResults.emplace(dist, label);
-                }
-                if (topResults.size() > k)
-                    topResults.pop();
 
-                if (!topResults.empty()) {
-                    lastdist = topResults.top().first;
+        size_t block_size = (cur_element_count + num_threads - 1) / num_threads;
+        std::vector<std::priority_queue<std::pair<dist_t, labeltype >>> partialResults(num_threads);
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < num_threads; t++) {
+            threads.emplace_back([&, t] {
+                searchRange(query_data, k, isIdAllowed, t * block_size,
+                            std::min(cur_element_count, (t + 1) * block_size), partialResults[t]);
+            });
+        }
+        searchRange(query_data, k, isIdAllowed, 0, block_size, partialResults[0]);
+        for (auto &thread : threads) {
+            thread.join();
+        }
+
+        for (auto &partial : partialResults) {
+            while (!partial.empty()) {
+                topResults.push(partial.top());
+                partial.pop();
+                if (topResults.size() > k) {
+                    topResults.pop();
                 }
             }
         }
@@ -143,19 +216,29 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
         writeBinaryPOD(output, size_per_element_);
         writeBinaryPOD(output, cur_element_count);
 
-        output.write(data_, maxelements_ * size_per_element_);
+        output.write(data_, cur_element_count * size_per_element_);
 
         output.close();
     }
 
 
-    void loadIndex(const std::string &location, SpaceInterface<dist_t> *s) {
+    // Also reads indexes saved with all `maxelements_` elements. `max_elements` overrides the capacity
+    // if it can hold the saved elements.
+    void loadIndex(const std::string &location, SpaceInterface<dist_t> *s, size_t max_elements = 0) {
         std::ifstream input(location, std::ios::binary);
-        std::streampos position;
+        if (!input.is_open())
+            throw std::runtime_error("Cannot open file");
+
+        loadIndex(input, s, max_elements);
+    }
 
+
+    void loadIndex(std::istream &input, SpaceInterface<dist_t> *s, size_t max_elements = 0) {
         readBinaryPOD(input, maxelements_);
         readBinaryPOD(input, size_per_element_);
         readBinaryPOD(input, cur_element_count);
+        if (max_elements >= cur_element_count && max_elements > 0)
+            maxelements_ = max_elements;
 
         data_size_ = s->get_data_size();
         fstdistfunc_ = s->get_dist_func();
@@ -165,9 +248,16 @@ class BruteforceSearch : public AlgorithmInterface<dist_t> {
         if (data_ == nullptr)
             throw std::runtime_error("Not enough memory: loadIndex failed to allocate data");
 
-        input.read(data_, maxelements_ * size_per_element_);
+        input.read(data_, cur_element_count * size_per_element_);
+        if (!input)
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
 
-        input.close();
+        dict_external_to_internal.clear();
+        for (size_t i = 0; i < cur_element_count; i++) {
+            labeltype label;
+            memcpy(&label, data_ + size_per_element_ * i + data_size_, sizeof(labeltype));
+            dict_external_to_internal[label] = i;
+        }
     }
 };
 }  // namespace hnswlib
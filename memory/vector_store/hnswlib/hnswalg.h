@@ -86,6 +86,16 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
     }
 
 
+    HierarchicalNSW(
+        SpaceInterface<dist_t> *s,
+        std::istream &input,
+        size_t max_elements = 0,
+        bool allow_replace_deleted = false)
+        : allow_replace_deleted_(allow_replace_deleted) {
+        loadIndex(input, s, max_elements);
+    }
+
+
     HierarchicalNSW(
         SpaceInterface<dist_t> *s,
         size_t max_elements,
@@ -719,6 +729,12 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         if (!input.is_open())
             throw std::runtime_error("Cannot open file");
 
+        loadIndex(input, s, max_elements_i);
+    }
+
+
+    // Index saved by `saveIndex` from any seekable stream (e.g. over a memory-mapped file)
+    void loadIndex(std::istream &input, SpaceInterface<dist_t> *s, size_t max_elements_i = 0) {
         clear();
         // get file size:
         input.seekg(0, input.end);
@@ -816,8 +832,6 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             }
         }
 
-        input.close();
-
         return;
     }
 
@@ -1016,7 +1030,8 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             for (auto&& elOneHop : listOneHop) {
                 sCand.insert(elOneHop);
 
-                if (distribution(update_probability_generator_) > updateNeighborProbability)
+                // The generator is shared by concurrent updates, only draw if some neighbors are to be skipped
+                if (updateNeighborProbability < 1.0f && distribution(update_probability_generator_) > updateNeighborProbability)
                     continue;
 
                 sNeigh.insert(elOneHop);
@@ -1152,6 +1167,7 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     tableint addPoint(const void *data_point, labeltype label, int level) {
         tableint cur_c = 0;
+        int curlevel;
         {
             // Checking if the element with the same label already exists
             // if so, updating it *instead* of creating a new element.
@@ -1181,10 +1197,10 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
             cur_c = cur_element_count;
             cur_element_count++;
             label_lookup_[label] = cur_c;
+            curlevel = getRandomLevel(mult_);  // The generator is shared by concurrent inserts
         }
 
         std::unique_lock <std::mutex> lock_el(link_list_locks_[cur_c]);
-        int curlevel = getRandomLevel(mult_);
         if (level > 0)
             curlevel = level;
 
@@ -1269,6 +1285,13 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
 
     std::priority_queue<std::pair<dist_t, labeltype >>
     searchKnn(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed = nullptr) const {
+        return searchKnn(query_data, k, isIdAllowed, ef_);
+    }
+
+
+    // With the size of the dynamic candidate list for this query only (`ef_` is shared by all queries)
+    std::priority_queue<std::pair<dist_t, labeltype >>
+    searchKnn(const void *query_data, size_t k, BaseFilterFunctor* isIdAllowed, size_t ef) const {
         std::priority_queue<std::pair<dist_t, labeltype >> result;
         if (cur_element_count == 0) return result;
 
@@ -1306,10 +1329,10 @@ class HierarchicalNSW : public AlgorithmInterface<dist_t> {
         bool bare_bone_search = !num_deleted_ && !isIdAllowed;
         if (bare_bone_search) {
             top_candidates = searchBaseLayerST<true>(
-                    currObj, query_data, std::max(ef_, k), isIdAllowed);
+                    currObj, query_data, std::max(ef, k), isIdAllowed);
         } else {
             top_candidates = searchBaseLayerST<false>(
-                    currObj, query_data, std::max(ef_, k), isIdAllowed);
+                    currObj, query_data, std::max(ef, k), isIdAllowed);
         }
 
         while (top_candidates.size() > k) {
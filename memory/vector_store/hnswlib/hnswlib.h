@@ -8,17 +8,27 @@
   #define HNSWERR HNSWLIB_ERR_OVERRIDE
 #endif
 
+// AVX / AVX2 (with FMA) / AVX-512 kernels are compiled regardless of the target flags (GCC and Clang through target
+// attributes, MSVC does not need them) and selected at runtime with CPUID, so a portable binary neither crashes on
+// older hosts nor falls back to SSE on newer ones
 #ifndef NO_MANUAL_VECTORIZATION
 #if (defined(__SSE__) || _M_IX86_FP > 0 || defined(_M_AMD64) || defined(_M_X64))
 #define USE_SSE
-#ifdef __AVX__
 #define USE_AVX
-#ifdef __AVX512F__
+#define USE_AVX2
 #define USE_AVX512
 #endif
 #endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define HNSWLIB_TARGET(features) __attribute__((target(features)))
+#else
+#define HNSWLIB_TARGET(features)
 #endif
-#endif
+#define HNSWLIB_TARGET_AVX HNSWLIB_TARGET("avx")
+#define HNSWLIB_TARGET_AVX2 HNSWLIB_TARGET("avx2")
+#define HNSWLIB_TARGET_AVX2_FMA HNSWLIB_TARGET("avx2,fma")
+#define HNSWLIB_TARGET_AVX512 HNSWLIB_TARGET("avx512f")
 
 #if defined(USE_AVX) || defined(USE_SSE)
 #ifdef _MSC_VER
@@ -44,9 +54,7 @@ static uint64_t xgetbv(unsigned int index) {
 }
 #endif
 
-#if defined(USE_AVX512)
 #include <immintrin.h>
-#endif
 
 #if defined(__GNUC__)
 #define PORTABLE_ALIGN32 __attribute__((aligned(32)))
@@ -86,6 +94,33 @@ static bool AVXCapable() {
     return HW_AVX && avxSupported;
 }
 
+static bool AVX2Capable() {
+    if (!AVXCapable()) return false;
+
+    int cpuInfo[4];
+    cpuid(cpuInfo, 0, 0);
+    if (cpuInfo[0] < 0x00000007) return false;
+
+    cpuid(cpuInfo, 0x00000007, 0);
+    return (cpuInfo[1] & ((int)1 << 5)) != 0;
+}
+
+static bool FMACapable() {
+    if (!AVXCapable()) return false;
+
+    int cpuInfo[4];
+    cpuid(cpuInfo, 0x00000001, 0);
+    return (cpuInfo[2] & ((int)1 << 12)) != 0;
+}
+
+static bool F16CCapable() {
+    if (!AVXCapable()) return false;
+
+    int cpuInfo[4];
+    cpuid(cpuInfo, 0x00000001, 0);
+    return (cpuInfo[2] & ((int)1 << 29)) != 0;
+}
+
 static bool AVX512Capable() {
     if (!AVXCapable()) return false;
 
@@ -223,6 +258,8 @@ AlgorithmInterface<dist_t>::searchKnnCloserFirst(const void* query_data, size_t
 
 #include "space_l2.h"
 #include "space_ip.h"
+#include "space_fp16.h"
+#include "space_int8.h"
 #include "stop_condition.h"
 #include "bruteforce.h"
 #include "hnswalg.h"
@@ -0,0 +1,226 @@
+#pragma once
+#include "hnswlib.h"
+#include <cmath>
+
+namespace hnswlib {
+
+// Vectors are stored as IEEE 754 half precision, `EncodeFP16` converts float vectors (data and queries)
+
+static inline uint16_t
+FloatToHalf(float value) {
+    uint32_t x;
+    memcpy(&x, &value, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    uint32_t mantissa = x & 0x7fffff;
+    int32_t exponent = (int32_t) ((x >> 23) & 0xff) - 127 + 15;
+
+    if (((x >> 23) & 0xff) == 0xff) {  // inf / nan
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    }
+    if (exponent >= 31) {  // overflow
+        return sign | 0x7c00;
+    }
+    if (exponent <= 0) {  // subnormal / underflow
+        if (exponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t rem = mantissa & ((1u << shift) - 1);
+        uint32_t mid = 1u << (shift - 1);
+        if (rem > mid || (rem == mid && (half & 1))) {
+            half++;
+        }
+        return sign | half;
+    }
+
+    uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+    uint32_t rem = mantissa & 0x1fff;
+    if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) {
+        half++;  // round to nearest even, a carry into the exponent is correct
+    }
+    return half;
+}
+
+static inline float
+HalfToFloat(uint16_t half) {
+    uint32_t sign = (uint32_t) (half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+
+    if (exponent == 0) {  // zero / subnormal
+        float value = std::ldexp((float) mantissa, -24);
+        return sign ? -value : value;
+    }
+
+    uint32_t x;
+    if (exponent == 31) {
+        x = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        x = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+    float value;
+    memcpy(&value, &x, sizeof(value));
+    return value;
+}
+
+static inline void
+EncodeFP16(const float *vector, void *data, size_t dim) {
+    uint16_t *out = (uint16_t *) data;
+    for (size_t i = 0; i < dim; i++) {
+        out[i] = FloatToHalf(vector[i]);
+    }
+}
+
+static inline void
+DecodeFP16(const void *data, float *vector, size_t dim) {
+    const uint16_t *in = (const uint16_t *) data;
+    for (size_t i = 0; i < dim; i++) {
+        vector[i] = HalfToFloat(in[i]);
+    }
+}
+
+static float
+L2SqrFP16(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const uint16_t *pVect1 = (const uint16_t *) pVect1v;
+    const uint16_t *pVect2 = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+
+    float res = 0;
+    for (size_t i = 0; i < qty; i++) {
+        float t = HalfToFloat(pVect1[i]) - HalfToFloat(pVect2[i]);
+        res += t * t;
+    }
+    return res;
+}
+
+static float
+InnerProductFP16(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const uint16_t *pVect1 = (const uint16_t *) pVect1v;
+    const uint16_t *pVect2 = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+
+    float res = 0;
+    for (size_t i = 0; i < qty; i++) {
+        res += HalfToFloat(pVect1[i]) * HalfToFloat(pVect2[i]);
+    }
+    return res;
+}
+
+static float
+InnerProductDistanceFP16(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    return 1.0f - InnerProductFP16(pVect1v, pVect2v, qty_ptr);
+}
+
+#if defined(USE_AVX)
+
+// Converts 8 halves per instruction
+HNSWLIB_TARGET("avx,f16c") static float
+L2SqrFP16AVX(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const uint16_t *pVect1 = (const uint16_t *) pVect1v;
+    const uint16_t *pVect2 = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty8 = qty >> 3 << 3;
+    float PORTABLE_ALIGN32 TmpRes[8];
+
+    __m256 sum = _mm256_set1_ps(0);
+    for (size_t i = 0; i < qty8; i += 8) {
+        __m256 v1 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (pVect1 + i)));
+        __m256 v2 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (pVect2 + i)));
+        __m256 diff = _mm256_sub_ps(v1, v2);
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(diff, diff));
+    }
+    _mm256_store_ps(TmpRes, sum);
+    float res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+
+    size_t qty_left = qty - qty8;
+    return res + L2SqrFP16(pVect1 + qty8, pVect2 + qty8, &qty_left);
+}
+
+HNSWLIB_TARGET("avx,f16c") static float
+InnerProductDistanceFP16AVX(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    const uint16_t *pVect1 = (const uint16_t *) pVect1v;
+    const uint16_t *pVect2 = (const uint16_t *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+    size_t qty8 = qty >> 3 << 3;
+    float PORTABLE_ALIGN32 TmpRes[8];
+
+    __m256 sum = _mm256_set1_ps(0);
+    for (size_t i = 0; i < qty8; i += 8) {
+        __m256 v1 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (pVect1 + i)));
+        __m256 v2 = _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (pVect2 + i)));
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(v1, v2));
+    }
+    _mm256_store_ps(TmpRes, sum);
+    float res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+
+    size_t qty_left = qty - qty8;
+    return 1.0f - (res + InnerProductFP16(pVect1 + qty8, pVect2 + qty8, &qty_left));
+}
+
+#endif
+
+class L2SpaceFP16 : public SpaceInterface<float> {
+    DISTFUNC<float> fstdistfunc_;
+    size_t data_size_;
+    size_t dim_;
+
+ public:
+    L2SpaceFP16(size_t dim) {
+        fstdistfunc_ = L2SqrFP16;
+#if defined(USE_AVX)
+        if (F16CCapable())
+            fstdistfunc_ = L2SqrFP16AVX;
+#endif
+        dim_ = dim;
+        data_size_ = dim * sizeof(uint16_t);
+    }
+
+    size_t get_data_size() {
+        return data_size_;
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return fstdistfunc_;
+    }
+
+    void *get_dist_func_param() {
+        return &dim_;
+    }
+
+    ~L2SpaceFP16() {}
+};
+
+class InnerProductSpaceFP16 : public SpaceInterface<float> {
+    DISTFUNC<float> fstdistfunc_;
+    size_t data_size_;
+    size_t dim_;
+
+ public:
+    InnerProductSpaceFP16(size_t dim) {
+        fstdistfunc_ = InnerProductDistanceFP16;
+#if defined(USE_AVX)
+        if (F16CCapable())
+            fstdistfunc_ = InnerProductDistanceFP16AVX;
+#endif
+        dim_ = dim;
+        data_size_ = dim * sizeof(uint16_t);
+    }
+
+    size_t get_data_size() {
+        return data_size_;
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return fstdistfunc_;
+    }
+
+    void *get_dist_func_param() {
+        return &dim_;
+    }
+
+    ~InnerProductSpaceFP16() {}
+};
+
+}  // namespace hnswlib
@@ -0,0 +1,199 @@
+#pragma once
+#include "hnswlib.h"
+#include <algorithm>
+#include <cmath>
+
+namespace hnswlib {
+
+// Symmetric scalar quantization with one scale per vector. Layout of an encoded vector:
+//   float scale, float squared norm (of the dequantized vector), int8 codes[dim]
+// Distances only need the integer dot product of the codes:
+//   |a - b|^2 = |a|^2 + |b|^2 - 2 * scale_a * scale_b * <codes_a, codes_b>
+//   1 - <a, b> = 1 - scale_a * scale_b * <codes_a, codes_b>
+
+static const size_t INT8_HEADER_SIZE = 2 * sizeof(float);
+
+static inline void
+EncodeInt8(const float *vector, void *data, size_t dim) {
+    float max_abs = 0;
+    for (size_t i = 0; i < dim; i++) {
+        max_abs = std::max(max_abs, std::fabs(vector[i]));
+    }
+    float scale = max_abs > 0 ? max_abs / 127.0f : 1.0f;
+
+    int8_t *codes = (int8_t *) data + INT8_HEADER_SIZE;
+    int64_t sqnorm = 0;
+    for (size_t i = 0; i < dim; i++) {
+        long q = std::lrint(vector[i] / scale);
+        q = std::min(127L, std::max(-127L, q));
+        codes[i] = (int8_t) q;
+        sqnorm += q * q;
+    }
+
+    float header[2] = {scale, scale * scale * (float) sqnorm};
+    memcpy(data, header, INT8_HEADER_SIZE);  // Elements are not necessarily 4-byte aligned
+}
+
+static inline void
+DecodeInt8(const void *data, float *vector, size_t dim) {
+    float scale;
+    memcpy(&scale, data, sizeof(scale));
+    const int8_t *codes = (const int8_t *) data + INT8_HEADER_SIZE;
+    for (size_t i = 0; i < dim; i++) {
+        vector[i] = codes[i] * scale;
+    }
+}
+
+static int32_t
+DotInt8(const int8_t *pVect1, const int8_t *pVect2, size_t qty) {
+    int32_t res = 0;
+    for (size_t i = 0; i < qty; i++) {
+        res += (int32_t) pVect1[i] * pVect2[i];
+    }
+    return res;
+}
+
+#if defined(USE_AVX2)
+
+HNSWLIB_TARGET_AVX2 static int32_t
+DotInt8AVX2(const int8_t *pVect1, const int8_t *pVect2, size_t qty) {
+    size_t qty16 = qty >> 4 << 4;
+    int32_t PORTABLE_ALIGN32 TmpRes[8];
+
+    __m256i sum = _mm256_setzero_si256();
+    for (size_t i = 0; i < qty16; i += 16) {
+        __m256i v1 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) (pVect1 + i)));
+        __m256i v2 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *) (pVect2 + i)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v1, v2));
+    }
+    _mm256_store_si256((__m256i *) TmpRes, sum);
+    int32_t res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+
+    return res + DotInt8(pVect1 + qty16, pVect2 + qty16, qty - qty16);
+}
+
+#endif
+
+#if defined(USE_SSE)
+
+// SSE2 only: bytes are sign-extended by unpacking them with themselves and shifting back arithmetically
+static int32_t
+DotInt8SSE(const int8_t *pVect1, const int8_t *pVect2, size_t qty) {
+    size_t qty16 = qty >> 4 << 4;
+    int32_t PORTABLE_ALIGN32 TmpRes[4];
+
+    __m128i sum = _mm_setzero_si128();
+    for (size_t i = 0; i < qty16; i += 16) {
+        __m128i v1 = _mm_loadu_si128((const __m128i *) (pVect1 + i));
+        __m128i v2 = _mm_loadu_si128((const __m128i *) (pVect2 + i));
+        __m128i v1_lo = _mm_srai_epi16(_mm_unpacklo_epi8(v1, v1), 8);
+        __m128i v1_hi = _mm_srai_epi16(_mm_unpackhi_epi8(v1, v1), 8);
+        __m128i v2_lo = _mm_srai_epi16(_mm_unpacklo_epi8(v2, v2), 8);
+        __m128i v2_hi = _mm_srai_epi16(_mm_unpackhi_epi8(v2, v2), 8);
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(v1_lo, v2_lo));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(v1_hi, v2_hi));
+    }
+    _mm_store_si128((__m128i *) TmpRes, sum);
+    int32_t res = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3];
+
+    return res + DotInt8(pVect1 + qty16, pVect2 + qty16, qty - qty16);
+}
+
+#endif
+
+typedef int32_t (*DOTFUNCINT8)(const int8_t *, const int8_t *, size_t);
+
+template <DOTFUNCINT8 Dot>
+static float
+L2SqrInt8(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    float header1[2], header2[2];
+    memcpy(header1, pVect1v, INT8_HEADER_SIZE);
+    memcpy(header2, pVect2v, INT8_HEADER_SIZE);
+
+    int32_t dot = Dot((const int8_t *) pVect1v + INT8_HEADER_SIZE, (const int8_t *) pVect2v + INT8_HEADER_SIZE, qty);
+    float res = header1[1] + header2[1] - 2.0f * header1[0] * header2[0] * (float) dot;
+    return res > 0 ? res : 0;
+}
+
+template <DOTFUNCINT8 Dot>
+static float
+InnerProductDistanceInt8(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    size_t qty = *((size_t *) qty_ptr);
+    float scale1, scale2;
+    memcpy(&scale1, pVect1v, sizeof(float));
+    memcpy(&scale2, pVect2v, sizeof(float));
+
+    int32_t dot = Dot((const int8_t *) pVect1v + INT8_HEADER_SIZE, (const int8_t *) pVect2v + INT8_HEADER_SIZE, qty);
+    return 1.0f - scale1 * scale2 * (float) dot;
+}
+
+class L2SpaceInt8 : public SpaceInterface<float> {
+    DISTFUNC<float> fstdistfunc_;
+    size_t data_size_;
+    size_t dim_;
+
+ public:
+    L2SpaceInt8(size_t dim) {
+        fstdistfunc_ = L2SqrInt8<DotInt8>;
+#if defined(USE_SSE)
+        fstdistfunc_ = L2SqrInt8<DotInt8SSE>;
+#endif
+#if defined(USE_AVX2)
+        if (AVX2Capable())
+            fstdistfunc_ = L2SqrInt8<DotInt8AVX2>;
+#endif
+        dim_ = dim;
+        data_size_ = INT8_HEADER_SIZE + dim * sizeof(int8_t);
+    }
+
+    size_t get_data_size() {
+        return data_size_;
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return fstdistfunc_;
+    }
+
+    void *get_dist_func_param() {
+        return &dim_;
+    }
+
+    ~L2SpaceInt8() {}
+};
+
+class InnerProductSpaceInt8 : public SpaceInterface<float> {
+    DISTFUNC<float> fstdistfunc_;
+    size_t data_size_;
+    size_t dim_;
+
+ public:
+    InnerProductSpaceInt8(size_t dim) {
+        fstdistfunc_ = InnerProductDistanceInt8<DotInt8>;
+#if defined(USE_SSE)
+        fstdistfunc_ = InnerProductDistanceInt8<DotInt8SSE>;
+#endif
+#if defined(USE_AVX2)
+        if (AVX2Capable())
+            fstdistfunc_ = InnerProductDistanceInt8<DotInt8AVX2>;
+#endif
+        dim_ = dim;
+        data_size_ = INT8_HEADER_SIZE + dim * sizeof(int8_t);
+    }
+
+    size_t get_data_size() {
+        return data_size_;
+    }
+
+    DISTFUNC<float> get_dist_func() {
+        return fstdistfunc_;
+    }
+
+    void *get_dist_func_param() {
+        return &dim_;
+    }
+
+    ~InnerProductSpaceInt8() {}
+};
+
+}  // namespace hnswlib
@@ -1,5 +1,6 @@
 #pragma once
 #include "hnswlib.h"
+#include <cmath>
 
 namespace hnswlib {
 
@@ -18,10 +19,86 @@ InnerProductDistance(const void *pVect1, const void *pVect2, const void *qty_ptr
     return 1.0f - InnerProduct(pVect1, pVect2, qty_ptr);
 }
 
+#if defined(USE_AVX2)
+
+// Every AVX2 host (Haswell and later) also has FMA. Two accumulators hide its latency.
+HNSWLIB_TARGET_AVX2_FMA static float
+InnerProductSIMD4ExtAVX2(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    float PORTABLE_ALIGN32 TmpRes[8];
+    float *pVect1 = (float *) pVect1v;
+    float *pVect2 = (float *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+
+    size_t qty16 = qty / 16;
+    size_t qty4 = qty / 4;
+
+    const float *pEnd1 = pVect1 + 16 * qty16;
+    const float *pEnd2 = pVect1 + 4 * qty4;
+
+    __m256 sum1 = _mm256_setzero_ps();
+    __m256 sum2 = _mm256_setzero_ps();
+
+    while (pVect1 < pEnd1) {
+        sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(pVect1), _mm256_loadu_ps(pVect2), sum1);
+        sum2 = _mm256_fmadd_ps(_mm256_loadu_ps(pVect1 + 8), _mm256_loadu_ps(pVect2 + 8), sum2);
+        pVect1 += 16;
+        pVect2 += 16;
+    }
+
+    __m256 sum256 = _mm256_add_ps(sum1, sum2);
+    __m128 sum_prod = _mm_add_ps(_mm256_extractf128_ps(sum256, 0), _mm256_extractf128_ps(sum256, 1));
+
+    while (pVect1 < pEnd2) {
+        sum_prod = _mm_fmadd_ps(_mm_loadu_ps(pVect1), _mm_loadu_ps(pVect2), sum_prod);
+        pVect1 += 4;
+        pVect2 += 4;
+    }
+
+    _mm_store_ps(TmpRes, sum_prod);
+    return TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3];
+}
+
+HNSWLIB_TARGET_AVX2_FMA static float
+InnerProductDistanceSIMD4ExtAVX2(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    return 1.0f - InnerProductSIMD4ExtAVX2(pVect1v, pVect2v, qty_ptr);
+}
+
+HNSWLIB_TARGET_AVX2_FMA static float
+InnerProductSIMD16ExtAVX2(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    float PORTABLE_ALIGN32 TmpRes[8];
+    float *pVect1 = (float *) pVect1v;
+    float *pVect2 = (float *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+
+    size_t qty16 = qty / 16;
+
+    const float *pEnd1 = pVect1 + 16 * qty16;
+
+    __m256 sum1 = _mm256_setzero_ps();
+    __m256 sum2 = _mm256_setzero_ps();
+
+    while (pVect1 < pEnd1) {
+        sum1 = _mm256_fmadd_ps(_mm256_loadu_ps(pVect1), _mm256_loadu_ps(pVect2), sum1);
+        sum2 = _mm256_fmadd_ps(_mm256_loadu_ps(pVect1 + 8), _mm256_loadu_ps(pVect2 + 8), sum2);
+        pVect1 += 16;
+        pVect2 += 16;
+    }
+
+    _mm256_store_ps(TmpRes, _mm256_add_ps(sum1, sum2));
+    return TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+}
+
+HNSWLIB_TARGET_AVX2_FMA static float
+InnerProductDistanceSIMD16ExtAVX2(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    return 1.0f - InnerProductSIMD16ExtAVX2(pVect1v, pVect2v, qty_ptr);
+}
+
+#endif
+
 #if defined(USE_AVX)
 
 // Favor using AVX if available.
-static float
+HNSWLIB_TARGET_AVX static float
 InnerProductSIMD4ExtAVX(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     float PORTABLE_ALIGN32 TmpRes[8];
     float *pVect1 = (float *) pVect1v;
@@ -68,7 +145,7 @@ InnerProductSIMD4ExtAVX(const void *pVect1v, const void *pVect2v, const void *qt
     return sum;
 }
 
-static float
+HNSWLIB_TARGET_AVX static float
 InnerProductDistanceSIMD4ExtAVX(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     return 1.0f - InnerProductSIMD4ExtAVX(pVect1v, pVect2v, qty_ptr);
 }
@@ -143,7 +220,7 @@ InnerProductDistanceSIMD4ExtSSE(const void *pVect1v, const void *pVect2v, const
 
 #if defined(USE_AVX512)
 
-static float
+HNSWLIB_TARGET_AVX512 static float
 InnerProductSIMD16ExtAVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     float PORTABLE_ALIGN64 TmpRes[16];
     float *pVect1 = (float *) pVect1v;
@@ -194,11 +271,16 @@ InnerProductSIMD16ExtAVX512(const void *pVect1v, const void *pVect2v, const void
         sum512 = _mm512_fmadd_ps(v1, v2, sum512);
     }
 
-    float sum = _mm512_reduce_add_ps(sum512);
+    // Not `_mm512_reduce_add_ps`: under a target attribute (instead of -mavx512f) GCC warns about the
+    // undefined vectors it is implemented with
+    _mm512_store_ps(TmpRes, sum512);
+    float sum = TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] +
+            TmpRes[7] + TmpRes[8] + TmpRes[9] + TmpRes[10] + TmpRes[11] + TmpRes[12] +
+            TmpRes[13] + TmpRes[14] + TmpRes[15];
     return sum;
 }
 
-static float
+HNSWLIB_TARGET_AVX512 static float
 InnerProductDistanceSIMD16ExtAVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     return 1.0f - InnerProductSIMD16ExtAVX512(pVect1v, pVect2v, qty_ptr);
 }
@@ -207,7 +289,7 @@ InnerProductDistanceSIMD16ExtAVX512(const void *pVect1v, const void *pVect2v, co
 
 #if defined(USE_AVX)
 
-static float
+HNSWLIB_TARGET_AVX static float
 InnerProductSIMD16ExtAVX(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     float PORTABLE_ALIGN32 TmpRes[8];
     float *pVect1 = (float *) pVect1v;
@@ -243,7 +325,7 @@ InnerProductSIMD16ExtAVX(const void *pVect1v, const void *pVect2v, const void *q
     return sum;
 }
 
-static float
+HNSWLIB_TARGET_AVX static float
 InnerProductDistanceSIMD16ExtAVX(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     return 1.0f - InnerProductSIMD16ExtAVX(pVect1v, pVect2v, qty_ptr);
 }
@@ -339,6 +421,76 @@ InnerProductDistanceSIMD4ExtResiduals(const void *pVect1v, const void *pVect2v,
 }
 #endif
 
+static float
+SquaredNorm(const float *pVect, size_t qty) {
+    float res = 0;
+    for (size_t i = 0; i < qty; i++) {
+        res += pVect[i] * pVect[i];
+    }
+    return res;
+}
+
+#if defined(USE_SSE)
+
+static float
+SquaredNormSSE(const float *pVect, size_t qty) {
+    float PORTABLE_ALIGN32 TmpRes[4];
+    size_t qty4 = qty >> 2 << 2;
+
+    __m128 sum = _mm_set1_ps(0);
+    for (size_t i = 0; i < qty4; i += 4) {
+        __m128 v = _mm_loadu_ps(pVect + i);
+        sum = _mm_add_ps(sum, _mm_mul_ps(v, v));
+    }
+    _mm_store_ps(TmpRes, sum);
+    return TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + SquaredNorm(pVect + qty4, qty - qty4);
+}
+
+#endif
+
+#if defined(USE_AVX)
+
+HNSWLIB_TARGET_AVX static float
+SquaredNormAVX(const float *pVect, size_t qty) {
+    float PORTABLE_ALIGN32 TmpRes[8];
+    size_t qty8 = qty >> 3 << 3;
+
+    __m256 sum = _mm256_set1_ps(0);
+    for (size_t i = 0; i < qty8; i += 8) {
+        __m256 v = _mm256_loadu_ps(pVect + i);
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(v, v));
+    }
+    _mm256_store_ps(TmpRes, sum);
+    return TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7]
+        + SquaredNorm(pVect + qty8, qty - qty8);
+}
+
+#endif
+
+// Scales `vector` to unit length into `out` (which may alias it), zero vectors are copied as is.
+// Normalizing once per vector lets cosine similarity run on the inner product kernels.
+static inline void
+NormalizeVector(const float *vector, float *out, size_t dim) {
+    typedef float (*SQNORMFUNC)(const float *, size_t);
+    static const SQNORMFUNC squared_norm = [] {
+        SQNORMFUNC func = SquaredNorm;
+#if defined(USE_SSE)
+        func = SquaredNormSSE;
+#endif
+#if defined(USE_AVX)
+        if (AVXCapable())
+            func = SquaredNormAVX;
+#endif
+        return func;
+    }();
+
+    float norm = std::sqrt(squared_norm(vector, dim));
+    float scale = norm > 0 ? 1.0f / norm : 1.0f;
+    for (size_t i = 0; i < dim; i++) {
+        out[i] = vector[i] * scale;
+    }
+}
+
 class InnerProductSpace : public SpaceInterface<float> {
     DISTFUNC<float> fstdistfunc_;
     size_t data_size_;
@@ -352,6 +504,9 @@ class InnerProductSpace : public SpaceInterface<float> {
         if (AVX512Capable()) {
             InnerProductSIMD16Ext = InnerProductSIMD16ExtAVX512;
             InnerProductDistanceSIMD16Ext = InnerProductDistanceSIMD16ExtAVX512;
+        } else if (AVX2Capable() && FMACapable()) {
+            InnerProductSIMD16Ext = InnerProductSIMD16ExtAVX2;
+            InnerProductDistanceSIMD16Ext = InnerProductDistanceSIMD16ExtAVX2;
         } else if (AVXCapable()) {
             InnerProductSIMD16Ext = InnerProductSIMD16ExtAVX;
             InnerProductDistanceSIMD16Ext = InnerProductDistanceSIMD16ExtAVX;
@@ -362,6 +517,12 @@ class InnerProductSpace : public SpaceInterface<float> {
             InnerProductDistanceSIMD16Ext = InnerProductDistanceSIMD16ExtAVX;
         }
     #endif
+    #if defined(USE_AVX2)
+        if (AVX2Capable() && FMACapable()) {
+            InnerProductSIMD4Ext = InnerProductSIMD4ExtAVX2;
+            InnerProductDistanceSIMD4Ext = InnerProductDistanceSIMD4ExtAVX2;
+        } else
+    #endif
     #if defined(USE_AVX)
         if (AVXCapable()) {
             InnerProductSIMD4Ext = InnerProductSIMD4ExtAVX;
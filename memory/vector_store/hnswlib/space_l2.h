@@ -22,7 +22,7 @@ L2Sqr(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
 #if defined(USE_AVX512)
 
 // Favor using AVX512 if available.
-static float
+HNSWLIB_TARGET_AVX512 static float
 L2SqrSIMD16ExtAVX512(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     float *pVect1 = (float *) pVect1v;
     float *pVect2 = (float *) pVect2v;
@@ -41,8 +41,7 @@ L2SqrSIMD16ExtAVX512(const void *pVect1v, const void *pVect2v, const void *qty_p
         v2 = _mm512_loadu_ps(pVect2);
         pVect2 += 16;
         diff = _mm512_sub_ps(v1, v2);
-        // sum = _mm512_fmadd_ps(diff, diff, sum);
-        sum = _mm512_add_ps(sum, _mm512_mul_ps(diff, diff));
+        sum = _mm512_fmadd_ps(diff, diff, sum);
     }
 
     _mm512_store_ps(TmpRes, sum);
@@ -54,10 +53,44 @@ L2SqrSIMD16ExtAVX512(const void *pVect1v, const void *pVect2v, const void *qty_p
 }
 #endif
 
+#if defined(USE_AVX2)
+
+// Every AVX2 host (Haswell and later) also has FMA. Two accumulators hide its latency.
+HNSWLIB_TARGET_AVX2_FMA static float
+L2SqrSIMD16ExtAVX2(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
+    float *pVect1 = (float *) pVect1v;
+    float *pVect2 = (float *) pVect2v;
+    size_t qty = *((size_t *) qty_ptr);
+    float PORTABLE_ALIGN32 TmpRes[8];
+    size_t qty16 = qty >> 4;
+
+    const float *pEnd1 = pVect1 + (qty16 << 4);
+
+    __m256 diff;
+    __m256 sum1 = _mm256_setzero_ps();
+    __m256 sum2 = _mm256_setzero_ps();
+
+    while (pVect1 < pEnd1) {
+        diff = _mm256_sub_ps(_mm256_loadu_ps(pVect1), _mm256_loadu_ps(pVect2));
+        sum1 = _mm256_fmadd_ps(diff, diff, sum1);
+
+        diff = _mm256_sub_ps(_mm256_loadu_ps(pVect1 + 8), _mm256_loadu_ps(pVect2 + 8));
+        sum2 = _mm256_fmadd_ps(diff, diff, sum2);
+
+        pVect1 += 16;
+        pVect2 += 16;
+    }
+
+    _mm256_store_ps(TmpRes, _mm256_add_ps(sum1, sum2));
+    return TmpRes[0] + TmpRes[1] + TmpRes[2] + TmpRes[3] + TmpRes[4] + TmpRes[5] + TmpRes[6] + TmpRes[7];
+}
+
+#endif
+
 #if defined(USE_AVX)
 
 // Favor using AVX if available.
-static float
+HNSWLIB_TARGET_AVX static float
 L2SqrSIMD16ExtAVX(const void *pVect1v, const void *pVect2v, const void *qty_ptr) {
     float *pVect1 = (float *) pVect1v;
     float *pVect2 = (float *) pVect2v;
@@ -217,6 +250,8 @@ class L2Space : public SpaceInterface<float> {
     #if defined(USE_AVX512)
         if (AVX512Capable())
             L2SqrSIMD16Ext = L2SqrSIMD16ExtAVX512;
+        else if (AVX2Capable() && FMACapable())
+            L2SqrSIMD16Ext = L2SqrSIMD16ExtAVX2;
         else if (AVXCapable())
             L2SqrSIMD16Ext = L2SqrSIMD16ExtAVX;
     #elif defined(USE_AVX)
@@ -0,0 +1,252 @@
+#include "hnswlib_mmap.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace humanus {
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef _WIN32
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    buffer_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + path + ": " + std::strerror(errno));
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Cannot stat " + path + ": " + std::strerror(errno));
+    }
+    size_ = st.st_size;
+    if (size_ > 0) { // Empty files cannot be mapped
+        void* addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("Cannot map " + path + ": " + std::strerror(errno));
+        }
+        ::madvise(addr, size_, MADV_SEQUENTIAL); // Read front to back once
+        data_ = static_cast<const char*>(addr);
+    }
+    ::close(fd); // The mapping keeps the file referenced
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (data_ != nullptr) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+}
+
+MappedFileStream::MappedFileStream(const MappedFile& file) : std::istream(static_cast<std::streambuf*>(this)) {
+    char* data = const_cast<char*>(file.data()); // Never written through, the get area only reads
+    setg(data, data, data + file.size());
+}
+
+std::streampos MappedFileStream::seekoff(std::streamoff off, std::ios_base::seekdir dir, std::ios_base::openmode which) {
+    if (!(which & std::ios_base::in)) {
+        return std::streampos(std::streamoff(-1));
+    }
+    char* base = dir == std::ios_base::beg ? eback() : dir == std::ios_base::cur ? gptr() : egptr();
+    if (off < eback() - base || off > egptr() - base) {
+        return std::streampos(std::streamoff(-1));
+    }
+    setg(eback(), base + off, egptr());
+    return std::streampos(gptr() - eback());
+}
+
+std::streampos MappedFileStream::seekpos(std::streampos pos, std::ios_base::openmode which) {
+    return seekoff(std::streamoff(pos), std::ios_base::beg, which);
+}
+
+MMapHierarchicalNSW::MMapHierarchicalNSW(hnswlib::SpaceInterface<float>* s, const std::string& file, size_t max_elements, size_t M, size_t ef_construction,
+                                         bool allow_replace_deleted)
+    : hnswlib::HierarchicalNSW<float>(s, 0, M, ef_construction, 100, allow_replace_deleted), file_(file) {
+    free(data_level0_memory_);
+    data_level0_memory_ = nullptr;
+    try {
+        resizeIndex(max_elements);
+    } catch (...) {
+        _close(); // The base destructor would `free` the mapping
+        throw;
+    }
+}
+
+MMapHierarchicalNSW::MMapHierarchicalNSW(hnswlib::SpaceInterface<float>* s, const std::string& file, std::istream& input, size_t max_elements,
+                                         bool allow_replace_deleted)
+    : hnswlib::HierarchicalNSW<float>(s), file_(file) {
+    allow_replace_deleted_ = allow_replace_deleted;
+    try {
+        _load(s, input, max_elements);
+    } catch (...) {
+        _close();
+        throw;
+    }
+}
+
+void MMapHierarchicalNSW::_load(hnswlib::SpaceInterface<float>* s, std::istream& input, size_t max_elements) {
+    // Same format as `HierarchicalNSW::loadIndex`
+    hnswlib::readBinaryPOD(input, offsetLevel0_);
+    size_t saved_max_elements;
+    hnswlib::readBinaryPOD(input, saved_max_elements);
+    size_t cur_count;
+    hnswlib::readBinaryPOD(input, cur_count);
+    hnswlib::readBinaryPOD(input, size_data_per_element_);
+    hnswlib::readBinaryPOD(input, label_offset_);
+    hnswlib::readBinaryPOD(input, offsetData_);
+    hnswlib::readBinaryPOD(input, maxlevel_);
+    hnswlib::readBinaryPOD(input, enterpoint_node_);
+    hnswlib::readBinaryPOD(input, maxM_);
+    hnswlib::readBinaryPOD(input, maxM0_);
+    hnswlib::readBinaryPOD(input, M_);
+    hnswlib::readBinaryPOD(input, mult_);
+    hnswlib::readBinaryPOD(input, ef_construction_);
+    if (!input) {
+        throw std::runtime_error("Index seems to be corrupted or unsupported");
+    }
+
+    data_size_ = s->get_data_size();
+    fstdistfunc_ = s->get_dist_func();
+    dist_func_param_ = s->get_dist_func_param();
+    size_links_per_element_ = maxM_ * sizeof(hnswlib::tableint) + sizeof(hnswlib::linklistsizeint);
+    size_links_level0_ = maxM0_ * sizeof(hnswlib::tableint) + sizeof(hnswlib::linklistsizeint);
+    revSize_ = 1.0 / mult_;
+    ef_ = 10;
+    std::vector<std::mutex>(MAX_LABEL_OPERATION_LOCKS).swap(label_op_locks_);
+
+    if (max_elements < cur_count) {
+        max_elements = std::max(saved_max_elements, cur_count);
+    }
+    resizeIndex(max_elements);
+
+    // Stream level 0 in chunks, so that it never has to be resident as a whole
+    const size_t chunk_size = 64 << 20;
+    size_t level0_size = cur_count * size_data_per_element_;
+    for (size_t offset = 0; offset < level0_size; offset += chunk_size) {
+        input.read(data_level0_memory_ + offset, std::min(chunk_size, level0_size - offset));
+    }
+    if (!input) {
+        throw std::runtime_error("Index seems to be corrupted or unsupported");
+    }
+    cur_element_count = cur_count;
+
+    for (size_t i = 0; i < cur_count; i++) {
+        label_lookup_[getExternalLabel(i)] = i;
+        unsigned int link_list_size;
+        hnswlib::readBinaryPOD(input, link_list_size);
+        if (!input || link_list_size % size_links_per_element_ != 0) {
+            cur_element_count = i; // Only free what has been allocated
+            throw std::runtime_error("Index seems to be corrupted or unsupported");
+        }
+        element_levels_[i] = link_list_size / size_links_per_element_;
+        linkLists_[i] = nullptr;
+        if (link_list_size > 0) {
+            linkLists_[i] = (char*) malloc(link_list_size);
+            if (linkLists_[i] == nullptr) {
+                cur_element_count = i;
+                throw std::runtime_error("Not enough memory: failed to allocate linklist");
+            }
+            input.read(linkLists_[i], link_list_size);
+        }
+    }
+
+    for (size_t i = 0; i < cur_count; i++) {
+        if (isMarkedDeleted(i)) {
+            num_deleted_ += 1;
+            if (allow_replace_deleted_) {
+                deleted_elements.insert(i);
+            }
+        }
+    }
+}
+
+MMapHierarchicalNSW::~MMapHierarchicalNSW() {
+    _close();
+}
+
+void MMapHierarchicalNSW::resizeIndex(size_t new_max_elements) {
+    if (new_max_elements < cur_element_count) {
+        throw std::runtime_error("Cannot resize, max element is less than the current number of elements");
+    }
+
+    visited_list_pool_.reset(new hnswlib::VisitedListPool(1, new_max_elements));
+    element_levels_.resize(new_max_elements);
+    std::vector<std::mutex>(new_max_elements).swap(link_list_locks_);
+
+    _map(new_max_elements);
+
+    char** link_lists_new = (char**) realloc(linkLists_, sizeof(void*) * std::max<size_t>(new_max_elements, 1));
+    if (link_lists_new == nullptr) {
+        throw std::runtime_error("Not enough memory: resizeIndex failed to allocate other layers");
+    }
+    linkLists_ = link_lists_new;
+
+    max_elements_ = new_max_elements;
+}
+
+void MMapHierarchicalNSW::_map(size_t max_elements) {
+#ifdef _WIN32
+    throw std::runtime_error("Memory-mapped vector stores are not supported on Windows");
+#else
+    if (fd_ < 0) {
+        fd_ = ::open(file_.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error("Cannot open " + file_ + ": " + std::strerror(errno));
+        }
+    }
+
+    _unmap(); // The contents stay in the file
+
+    size_t size = std::max<size_t>(max_elements * size_data_per_element_, 1);
+    if (::ftruncate(fd_, size) != 0) {
+        throw std::runtime_error("Cannot resize " + file_ + ": " + std::strerror(errno));
+    }
+    void* addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (addr == MAP_FAILED) {
+        throw std::runtime_error("Cannot map " + file_ + ": " + std::strerror(errno));
+    }
+    ::madvise(addr, size, MADV_RANDOM); // Graph traversal has no locality, read-ahead would only evict useful pages
+
+    data_level0_memory_ = static_cast<char*>(addr);
+    mapped_size_ = size;
+#endif
+}
+
+void MMapHierarchicalNSW::_unmap() {
+#ifndef _WIN32
+    if (data_level0_memory_ != nullptr && mapped_size_ > 0) {
+        ::munmap(data_level0_memory_, mapped_size_);
+    }
+#endif
+    data_level0_memory_ = nullptr;
+    mapped_size_ = 0;
+}
+
+void MMapHierarchicalNSW::_close() {
+    _unmap();
+#ifndef _WIN32
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+#endif
+}
+
+}
@@ -0,0 +1,87 @@
+#ifndef HUMANUS_MEMORY_VECTOR_STORE_HNSWLIB_MMAP_H
+#define HUMANUS_MEMORY_VECTOR_STORE_HNSWLIB_MMAP_H
+
+#include "hnswlib/hnswlib.h"
+#include <istream>
+#include <streambuf>
+#include <string>
+
+namespace humanus {
+
+// Read-only mapping of a whole file, so that snapshots and the write-ahead log are parsed in place and paged in
+// by the OS (with read-ahead) instead of being copied through a stream. Read into a buffer on Windows.
+class MappedFile {
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    std::string buffer_;
+
+public:
+    explicit MappedFile(const std::string& path);
+
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+};
+
+// Seekable `std::istream` over a `MappedFile`, for the index loaders of hnswlib
+class MappedFileStream : private std::streambuf, public std::istream {
+protected:
+    std::streampos seekoff(std::streamoff off, std::ios_base::seekdir dir, std::ios_base::openmode which) override;
+
+    std::streampos seekpos(std::streampos pos, std::ios_base::openmode which) override;
+
+public:
+    explicit MappedFileStream(const MappedFile& file);
+};
+
+// `hnswlib::HierarchicalNSW` whose level 0 block (vectors, level 0 links and labels, i.e. almost all of the index)
+// lives in a shared memory-mapped file instead of the heap. Pages are faulted in on demand and written back / dropped
+// by the OS under memory pressure, so the resident size is bounded by the working set rather than by capacity.
+// The file is scratch space: it is truncated on open, durability comes from snapshots and the write-ahead log.
+// Upper level links (about 1/M of the elements) and bookkeeping stay on the heap.
+class MMapHierarchicalNSW : public hnswlib::HierarchicalNSW<float> {
+private:
+    std::string file_;
+    int fd_ = -1;
+    size_t mapped_size_ = 0;
+
+    // Grow (or create) the file to hold `max_elements` elements and map it
+    void _map(size_t max_elements);
+
+    void _unmap();
+
+    void _close();
+
+    void _load(hnswlib::SpaceInterface<float>* s, std::istream& input, size_t max_elements);
+
+public:
+    // Empty index
+    MMapHierarchicalNSW(hnswlib::SpaceInterface<float>* s, const std::string& file, size_t max_elements, size_t M = 16, size_t ef_construction = 200,
+                        bool allow_replace_deleted = false);
+
+    // Index saved by `saveIndex`, level 0 is streamed into the mapping
+    MMapHierarchicalNSW(hnswlib::SpaceInterface<float>* s, const std::string& file, std::istream& input, size_t max_elements = 0,
+                        bool allow_replace_deleted = false);
+
+    ~MMapHierarchicalNSW();
+
+    MMapHierarchicalNSW(const MMapHierarchicalNSW&) = delete;
+    MMapHierarchicalNSW& operator=(const MMapHierarchicalNSW&) = delete;
+
+    // Hides `HierarchicalNSW::resizeIndex`, which would `realloc` the mapping
+    void resizeIndex(size_t new_max_elements);
+};
+
+}
+
+#endif // HUMANUS_MEMORY_VECTOR_STORE_HNSWLIB_MMAP_H
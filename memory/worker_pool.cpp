@@ -0,0 +1,106 @@
+#include "worker_pool.h"
+#include <algorithm>
+
+namespace humanus {
+
+WorkerPool::WorkerPool(size_t num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 1; i < num_threads; ++i) { // The calling thread works too
+        workers_.emplace_back(&WorkerPool::_work, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+void WorkerPool::_run_task(std::unique_lock<std::mutex>& lock, size_t task) {
+    lock.unlock();
+    std::exception_ptr error;
+    try {
+        task_(task);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    lock.lock();
+    if (error && !error_) {
+        error_ = error;
+    }
+}
+
+void WorkerPool::_work() {
+    size_t seen_generation = 0;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        cv_.wait(lock, [&] { return stop_ || (generation_ != seen_generation && next_task_ < num_tasks_); });
+        if (stop_) {
+            return;
+        }
+        while (next_task_ < num_tasks_) {
+            _run_task(lock, next_task_++);
+            if (++num_done_ == num_tasks_) {
+                done_cv_.notify_all();
+            }
+        }
+        seen_generation = generation_;
+    }
+}
+
+void WorkerPool::run(size_t num_tasks, const std::function<void(size_t)>& task) {
+    if (num_tasks == 0) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (busy_ || workers_.empty() || num_tasks == 1) {
+        lock.unlock();
+        std::exception_ptr error;
+        for (size_t t = 0; t < num_tasks; t++) {
+            try {
+                task(t);
+            } catch (...) {
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return;
+    }
+
+    busy_ = true;
+    task_ = task;
+    num_tasks_ = num_tasks;
+    next_task_ = 0;
+    num_done_ = 0;
+    error_ = nullptr;
+    generation_++;
+    cv_.notify_all();
+
+    while (next_task_ < num_tasks_) {
+        _run_task(lock, next_task_++);
+        num_done_++;
+    }
+    done_cv_.wait(lock, [&] { return num_done_ == num_tasks_; });
+
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    task_ = nullptr;
+    busy_ = false;
+    lock.unlock();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+} // namespace humanus
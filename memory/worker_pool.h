@@ -0,0 +1,52 @@
+#ifndef HUMANUS_MEMORY_WORKER_POOL_H
+#define HUMANUS_MEMORY_WORKER_POOL_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace humanus {
+
+// Persistent workers for data-parallel loops, started once and reused by every `run`
+class WorkerPool {
+private:
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable done_cv_;
+    std::function<void(size_t)> task_;
+    size_t num_tasks_ = 0;
+    size_t next_task_ = 0;
+    size_t num_done_ = 0;
+    size_t generation_ = 0;
+    std::exception_ptr error_;
+    bool busy_ = false;
+    bool stop_ = false;
+
+    void _work();
+
+    // Runs the claimed `task` with `lock` released, keeps the first exception
+    void _run_task(std::unique_lock<std::mutex>& lock, size_t task);
+
+public:
+    // `num_threads` includes the calling thread, 0 for one per core
+    explicit WorkerPool(size_t num_threads = 0);
+
+    ~WorkerPool();
+
+    size_t size() const {
+        return workers_.size() + 1;
+    }
+
+    // Run `task(i)` for i in [0, num_tasks) on the workers and the calling thread, blocks until all are done.
+    // The first exception is rethrown once all tasks are done. While the pool is busy (a concurrent `run`,
+    // or one from within a task) the calling thread runs all of its tasks itself.
+    void run(size_t num_tasks, const std::function<void(size_t)>& task);
+};
+
+} // namespace humanus
+
+#endif // HUMANUS_MEMORY_WORKER_POOL_H
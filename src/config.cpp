@@ -171,11 +171,61 @@ EmbeddingModelConfig EmbeddingModelConfig::load_from_toml(const toml::table& con
 
         if (config_table.contains("embedding_dims")) {
             config.embedding_dims = config_table["embedding_dims"].as_integer()->get();
+        } else if (config_table.contains("embeddings_dim")) { // Spelling of the example config
+            config.embedding_dims = config_table["embeddings_dim"].as_integer()->get();
         }
 
         if (config_table.contains("max_retries")) {
             config.max_retries = config_table["max_retries"].as_integer()->get();
         }
+
+        if (config_table.contains("encoding_format")) {
+            config.encoding_format = config_table["encoding_format"].as_string()->get();
+            if (config.encoding_format != "float" && config.encoding_format != "base64") {
+                throw std::runtime_error("Invalid encoding_format: " + config.encoding_format);
+            }
+        }
+
+        if (config_table.contains("max_batch_size")) {
+            config.max_batch_size = config_table["max_batch_size"].as_integer()->get();
+            if (config.max_batch_size <= 0) {
+                throw std::runtime_error("max_batch_size must be positive");
+            }
+        }
+
+        if (config_table.contains("max_batch_tokens")) {
+            config.max_batch_tokens = config_table["max_batch_tokens"].as_integer()->get();
+            if (config.max_batch_tokens <= 0) {
+                throw std::runtime_error("max_batch_tokens must be positive");
+            }
+        }
+
+        if (config_table.contains("batch_window_ms")) {
+            config.batch_window_ms = config_table["batch_window_ms"].as_integer()->get();
+        }
+
+        if (config_table.contains("cache_size")) {
+            config.cache_size = config_table["cache_size"].as_integer()->get();
+        }
+
+        if (config_table.contains("cache_path")) {
+            config.cache_path = config_table["cache_path"].as_string()->get();
+        }
+
+        if (config_table.contains("cache_file_size")) {
+            config.cache_file_size = config_table["cache_file_size"].as_integer()->get();
+        }
+
+        if (config_table.contains("model_path")) {
+            config.model_path = config_table["model_path"].as_string()->get();
+            if (std::filesystem::path(config.model_path).is_relative()) {
+                config.model_path = (PROJECT_ROOT / config.model_path).string();
+            }
+        }
+
+        if (config_table.contains("num_threads")) {
+            config.num_threads = config_table["num_threads"].as_integer()->get();
+        }
     } catch (const std::exception& e) {
         logger->error("Failed to load embedding model configuration: " + std::string(e.what()));
         throw;
@@ -208,16 +258,82 @@ VectorStoreConfig VectorStoreConfig::load_from_toml(const toml::table& config_ta
             config.ef_construction = config_table["ef_construction"].as_integer()->get();
         }
 
+        if (config_table.contains("ef_search")) {
+            config.ef_search = config_table["ef_search"].as_integer()->get();
+        }
+
+        if (config_table.contains("recall_target")) {
+            config.recall_target = config_table["recall_target"].as_floating_point()->get();
+        }
+
+        if (config_table.contains("recall_sample_interval")) {
+            config.recall_sample_interval = config_table["recall_sample_interval"].as_integer()->get();
+        }
+
+        if (config_table.contains("max_elements_per_tenant")) {
+            config.max_elements_per_tenant = config_table["max_elements_per_tenant"].as_integer()->get();
+        }
+
+        if (config_table.contains("path")) {
+            config.path = config_table["path"].as_string()->get();
+            if (!config.path.empty() && std::filesystem::path(config.path).is_relative()) {
+                config.path = (PROJECT_ROOT / config.path).string();
+            }
+        }
+
+        if (config_table.contains("snapshot_interval")) {
+            config.snapshot_interval = config_table["snapshot_interval"].as_integer()->get();
+        }
+
         if (config_table.contains("metric")) {
             const auto& metric_str = config_table["metric"].as_string()->get();
             if (metric_str == "L2") {
                 config.metric = VectorStoreConfig::Metric::L2;
             } else if (metric_str == "IP") {
                 config.metric = VectorStoreConfig::Metric::IP;
+            } else if (metric_str == "Cosine") {
+                config.metric = VectorStoreConfig::Metric::COSINE;
             } else {
                 throw std::runtime_error("Invalid metric: " + metric_str);
             }
         }
+
+        if (config_table.contains("quantization")) {
+            const auto& quantization_str = config_table["quantization"].as_string()->get();
+            if (quantization_str == "none") {
+                config.quantization = VectorStoreConfig::Quantization::NONE;
+            } else if (quantization_str == "fp16") {
+                config.quantization = VectorStoreConfig::Quantization::FP16;
+            } else if (quantization_str == "int8") {
+                config.quantization = VectorStoreConfig::Quantization::INT8;
+            } else {
+                throw std::runtime_error("Invalid quantization: " + quantization_str);
+            }
+        }
+
+        if (config_table.contains("rerank_factor")) {
+            config.rerank_factor = config_table["rerank_factor"].as_integer()->get();
+        }
+
+        if (config_table.contains("auto_threshold")) {
+            config.auto_threshold = config_table["auto_threshold"].as_integer()->get();
+        }
+
+        if (config_table.contains("filter_scan_threshold")) {
+            config.filter_scan_threshold = config_table["filter_scan_threshold"].as_integer()->get();
+        }
+
+        if (config_table.contains("memory_budget_mb")) {
+            config.memory_budget_mb = config_table["memory_budget_mb"].as_integer()->get();
+        }
+
+        if (config_table.contains("compaction_threshold")) {
+            config.compaction_threshold = config_table["compaction_threshold"].as_floating_point()->get();
+        }
+
+        if (config.provider == "hnswlib_mmap" && config.path.empty()) {
+            throw std::runtime_error("Provider hnswlib_mmap requires a path");
+        }
     } catch (const std::exception& e) {
         logger->error("Failed to load vector store configuration: " + std::string(e.what()));
         throw;
@@ -251,6 +367,47 @@ MemoryConfig MemoryConfig::load_from_toml(const toml::table& config_table) {
             config.retrieval_limit = config_table["retrieval_limit"].as_integer()->get();
         }
 
+        if (config_table.contains("tenant")) {
+            config.tenant = config_table["tenant"].as_string()->get();
+        }
+
+        if (config_table.contains("update_distance_threshold")) {
+            config.update_distance_threshold = config_table["update_distance_threshold"].as_floating_point()->get();
+        }
+
+        // Consolidation config
+        if (config_table.contains("async_consolidation")) {
+            config.async_consolidation = config_table["async_consolidation"].as_boolean()->get();
+        }
+
+        if (config_table.contains("max_pending_consolidations")) {
+            config.max_pending_consolidations = config_table["max_pending_consolidations"].as_integer()->get();
+            if (config.max_pending_consolidations <= 0) {
+                throw std::runtime_error("max_pending_consolidations must be positive");
+            }
+        }
+
+        if (config_table.contains("consolidation_batch_messages")) {
+            config.consolidation_batch_messages = config_table["consolidation_batch_messages"].as_integer()->get();
+        }
+
+        if (config_table.contains("consolidation_batch_tokens")) {
+            config.consolidation_batch_tokens = config_table["consolidation_batch_tokens"].as_integer()->get();
+        }
+
+        if (config_table.contains("consolidation_window_ms")) {
+            config.consolidation_window_ms = config_table["consolidation_window_ms"].as_integer()->get();
+        }
+
+        // Summary config
+        if (config_table.contains("rolling_summary")) {
+            config.rolling_summary = config_table["rolling_summary"].as_boolean()->get();
+        }
+
+        if (config_table.contains("max_tokens_summary")) {
+            config.max_tokens_summary = config_table["max_tokens_summary"].as_integer()->get();
+        }
+
         // Prompt config
         if (config_table.contains("fact_extraction_prompt")) {
             config.fact_extraction_prompt = config_table["fact_extraction_prompt"].as_string()->get();
@@ -259,6 +416,10 @@ MemoryConfig MemoryConfig::load_from_toml(const toml::table& config_table) {
         if (config_table.contains("update_memory_prompt")) {
             config.update_memory_prompt = config_table["update_memory_prompt"].as_string()->get();
         }
+
+        if (config_table.contains("summary_prompt")) {
+            config.summary_prompt = config_table["summary_prompt"].as_string()->get();
+        }
         
         // EmbeddingModel config
         if (config_table.contains("embedding_model")) {
@@ -3,6 +3,7 @@
 namespace humanus {
 
 std::unordered_map<std::string, std::shared_ptr<LLM>> LLM::instances_;
+std::mutex LLM::instances_mutex_;
 
 /**
  * @brief Format the message list to the format that LLM can accept
@@ -247,6 +247,21 @@ Please note to return the IDs in the output from the input IDs only and do not g
 Please call the `memory` tool to return the memory events.
 )";
 
+const char* SUMMARY_PROMPT = R"(You maintain a running summary of a conversation between a user and an AI agent. Older messages no longer fit in the agent's context, so they are removed and handed to you together with the previous summary.
+
+The previous summary is enclosed in <summary></summary> tags and the removed messages in <input></input> tags. Update the summary so that it keeps everything the agent still needs to continue its work:
+- The user's goals, constraints and preferences
+- Decisions made and the reasons behind them
+- Important results of tool calls (file paths, identifiers, numbers, errors)
+- Open questions and next steps
+
+Drop details that are no longer relevant. Write plain text in the same language as the conversation and keep the summary under {max_tokens} tokens.
+
+Current request: {current_request}
+
+Only return the updated summary, without any tags or explanations.
+)";
+
 } // namespace prompt
 
 } // namespace humanus 
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "../memory/embedding_model/cached.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace humanus;
+
+static int num_failed = 0;
+
+#define TEST_FAILED(func, message) do { std::cout << func << " \033[31mfailed\033[0m " << message << std::endl; num_failed++; } while (0)
+#define TEST_PASSED(func) std::cout << func << " \033[32mpassed\033[0m" << std::endl
+
+// Embeds a text as its length, counting the texts it was asked for
+class CountingEmbeddingModel : public EmbeddingModel {
+public:
+    size_t num_embedded = 0;
+    float scale;
+
+    CountingEmbeddingModel(const std::shared_ptr<EmbeddingModelConfig>& config, float scale = 1.0f) : EmbeddingModel(config), scale(scale) {}
+
+    std::vector<float> embed(const std::string& text, EmbeddingType /* type */) override {
+        num_embedded++;
+        return {scale * text.size(), 1.0f};
+    }
+};
+
+static std::string cache_path(const std::string& name) {
+    auto path = std::filesystem::temp_directory_path() / ("humanus_test_embedding_cache_" + name + ".embd");
+    std::filesystem::remove(path);
+    return path.string();
+}
+
+// Number of records in a cache file (32-byte key, uint32 dimension, 2 floats here)
+static size_t num_records(const std::string& path) {
+    return std::filesystem::file_size(path) / (32 + sizeof(uint32_t) + 2 * sizeof(float));
+}
+
+void test_file_size_limit() {
+    auto config = std::make_shared<EmbeddingModelConfig>();
+    config->cache_size = 0; // Disk tier only
+    config->cache_path = cache_path("limit");
+    config->cache_file_size = 8;
+
+    auto model = std::make_shared<CountingEmbeddingModel>(config);
+    {
+        CachedEmbeddingModel cache(config, model);
+        for (int round = 0; round < 3; round++) {
+            for (int i = 0; i < 20; i++) {
+                cache.embed("text " + std::to_string(i), EmbeddingType::ADD);
+                cache.embed("hot", EmbeddingType::ADD); // Used all the time, must survive compactions
+            }
+        }
+        if (num_records(config->cache_path) > 8) {
+            TEST_FAILED(__func__, "Expected at most 8 records in the cache file, got " + std::to_string(num_records(config->cache_path)));
+            return;
+        }
+    }
+    if (model->num_embedded != 3 * 20 + 1) {
+        TEST_FAILED(__func__, "Expected \"hot\" to be embedded once and the rest every round, got " + std::to_string(model->num_embedded) + " embeddings");
+        return;
+    }
+
+    CachedEmbeddingModel cache(config, model); // Reloaded
+    size_t before = model->num_embedded;
+    if (cache.embed("hot", EmbeddingType::ADD)[0] != 3.0f || cache.embed("text 19", EmbeddingType::ADD)[0] != 7.0f || model->num_embedded != before) {
+        TEST_FAILED(__func__, "Expected the most recently used embeddings to be kept across compactions and restarts");
+        return;
+    }
+    cache.embed("text 0", EmbeddingType::ADD);
+    if (model->num_embedded != before + 1) {
+        TEST_FAILED(__func__, "Expected the least recently used embeddings to be dropped");
+        return;
+    }
+    std::filesystem::remove(config->cache_path);
+
+    TEST_PASSED(__func__);
+}
+
+void test_local_model_key() {
+    auto dir = std::filesystem::temp_directory_path();
+    auto path = cache_path("local");
+    std::vector<float> embeddings;
+    for (const auto& [name, scale] : std::vector<std::pair<std::string, float>>{{"a", 1.0f}, {"b", 2.0f}, {"a", 1.0f}}) {
+        auto model_path = (dir / ("humanus_test_embedding_cache_" + name + ".gguf")).string();
+        std::ofstream(model_path) << name;
+
+        auto config = std::make_shared<EmbeddingModelConfig>();
+        config->provider = "local";
+        config->model_path = model_path; // Same config name and `model`, other weights
+        config->cache_path = path;
+        CachedEmbeddingModel cache(config, std::make_shared<CountingEmbeddingModel>(config, scale));
+        embeddings.push_back(cache.embed("text", EmbeddingType::ADD)[0]);
+    }
+    if (embeddings != std::vector<float>{4.0f, 8.0f, 4.0f}) {
+        TEST_FAILED(__func__, "Expected embeddings of each GGUF file to be cached separately");
+        return;
+    }
+    std::filesystem::remove(path);
+    std::filesystem::remove(dir / "humanus_test_embedding_cache_a.gguf");
+    std::filesystem::remove(dir / "humanus_test_embedding_cache_b.gguf");
+
+    TEST_PASSED(__func__);
+}
+
+int main() {
+    try {
+        test_file_size_limit();
+
+        test_local_model_key();
+    } catch (const std::exception& e) {
+        TEST_FAILED("test_embedding_cache", "Error: " + std::string(e.what()));
+    }
+    return num_failed > 0 ? 1 : 0;
+}
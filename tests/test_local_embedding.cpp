@@ -0,0 +1,314 @@
+#include "../memory/embedding_model/gguf.h"
+#include "../memory/embedding_model/local.h"
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace humanus;
+
+static int num_failed = 0;
+
+#define TEST_FAILED(func, message) do { std::cout << func << " \033[31mfailed\033[0m " << message << std::endl; num_failed++; } while (0)
+#define TEST_PASSED(func) std::cout << func << " \033[32mpassed\033[0m" << std::endl
+
+// Builds a GGUF v3 file in memory (default alignment of 32 bytes)
+class GGUFWriter {
+private:
+    std::string kv_, tensor_infos_, data_;
+    uint64_t num_kv_ = 0, num_tensors_ = 0;
+
+    template <typename T>
+    static void put(std::string& out, T value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    static void put_string(std::string& out, const std::string& str) {
+        put<uint64_t>(out, str.size());
+        out += str;
+    }
+
+    void key(const std::string& key, uint32_t type) {
+        put_string(kv_, key);
+        put<uint32_t>(kv_, type);
+        num_kv_++;
+    }
+
+public:
+    void add_string(const std::string& k, const std::string& value) {
+        key(k, 8);
+        put_string(kv_, value);
+    }
+
+    void add_uint32(const std::string& k, uint32_t value) {
+        key(k, 4);
+        put<uint32_t>(kv_, value);
+    }
+
+    void add_float32(const std::string& k, float value) {
+        key(k, 6);
+        put<float>(kv_, value);
+    }
+
+    void add_strings(const std::string& k, const std::vector<std::string>& values) {
+        key(k, 9);
+        put<uint32_t>(kv_, 8);
+        put<uint64_t>(kv_, values.size());
+        for (const auto& value : values) {
+            put_string(kv_, value);
+        }
+    }
+
+    // `bytes` already encoded in `type`
+    void add_tensor(const std::string& name, const std::vector<uint64_t>& dims, uint32_t type, const std::string& bytes) {
+        data_.resize((data_.size() + 31) / 32 * 32, '\0');
+        put_string(tensor_infos_, name);
+        put<uint32_t>(tensor_infos_, dims.size());
+        for (auto dim : dims) {
+            put<uint64_t>(tensor_infos_, dim);
+        }
+        put<uint32_t>(tensor_infos_, type);
+        put<uint64_t>(tensor_infos_, data_.size());
+        data_ += bytes;
+        num_tensors_++;
+    }
+
+    void add_tensor(const std::string& name, const std::vector<uint64_t>& dims, const std::vector<float>& values) {
+        add_tensor(name, dims, GGML_TYPE_F32, std::string(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(float)));
+    }
+
+    std::string str() const {
+        std::string out;
+        put<uint32_t>(out, 0x46554747); // "GGUF"
+        put<uint32_t>(out, 3);
+        put<uint64_t>(out, num_tensors_);
+        put<uint64_t>(out, num_kv_);
+        out += kv_ + tensor_infos_;
+        out.resize((out.size() + 31) / 32 * 32, '\0');
+        return out + data_;
+    }
+
+    void write(const std::string& path) const {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        auto content = str();
+        file.write(content.data(), content.size());
+    }
+};
+
+static const int n_embd = 4, n_ff = 8, n_ctx = 16;
+
+static std::vector<float> weights(size_t n, float seed) {
+    std::vector<float> values(n);
+    for (size_t i = 0; i < n; i++) {
+        values[i] = 0.5f * std::sin(seed + 0.37f * i);
+    }
+    return values;
+}
+
+// A one-layer `bert` model with the given vocabulary
+static GGUFWriter tiny_bert(const std::vector<std::string>& vocab) {
+    GGUFWriter writer;
+    writer.add_string("general.architecture", "bert");
+    writer.add_uint32("bert.embedding_length", n_embd);
+    writer.add_uint32("bert.block_count", 1);
+    writer.add_uint32("bert.attention.head_count", 1);
+    writer.add_uint32("bert.feed_forward_length", n_ff);
+    writer.add_uint32("bert.context_length", n_ctx);
+    writer.add_float32("bert.attention.layer_norm_epsilon", 1e-12f);
+    writer.add_strings("tokenizer.ggml.tokens", vocab);
+
+    const uint64_t d = n_embd, ff = n_ff;
+    writer.add_tensor("token_embd.weight", {d, vocab.size()}, weights(d * vocab.size(), 1.0f));
+    writer.add_tensor("position_embd.weight", {d, n_ctx}, weights(d * n_ctx, 2.0f));
+    writer.add_tensor("token_embd_norm.weight", {d}, std::vector<float>(d, 1.0f));
+    writer.add_tensor("token_embd_norm.bias", {d}, std::vector<float>(d, 0.0f));
+    writer.add_tensor("blk.0.attn_q.weight", {d, d}, weights(d * d, 3.0f));
+    writer.add_tensor("blk.0.attn_k.weight", {d, d}, weights(d * d, 4.0f));
+    writer.add_tensor("blk.0.attn_v.weight", {d, d}, weights(d * d, 5.0f));
+    writer.add_tensor("blk.0.attn_output.weight", {d, d}, weights(d * d, 6.0f));
+    writer.add_tensor("blk.0.attn_output_norm.weight", {d}, std::vector<float>(d, 1.0f));
+    writer.add_tensor("blk.0.ffn_up.weight", {d, ff}, weights(d * ff, 7.0f));
+    writer.add_tensor("blk.0.ffn_down.weight", {ff, d}, weights(d * ff, 8.0f));
+    writer.add_tensor("blk.0.layer_output_norm.weight", {d}, std::vector<float>(d, 1.0f));
+    return writer;
+}
+
+static const std::vector<std::string> bert_vocab = {
+    "[PAD]", "[UNK]", "[CLS]", "[SEP]", "un", "##aff", "##able", "hello", "world", ",", "!", "##s", "play", "##ing", "你", "好"
+};
+
+static std::string fixture_path(const std::string& name) {
+    return (std::filesystem::temp_directory_path() / ("humanus_test_local_embedding_" + name + ".gguf")).string();
+}
+
+static std::shared_ptr<LocalEmbeddingModel> load_model(const std::string& path) {
+    auto config = std::make_shared<EmbeddingModelConfig>();
+    config->provider = "local";
+    config->model_path = path;
+    config->embedding_dims = n_embd;
+    config->num_threads = 1;
+    return std::make_shared<LocalEmbeddingModel>(config);
+}
+
+static std::string to_string(const std::vector<int>& ids) {
+    std::string str;
+    for (auto id : ids) {
+        str += std::to_string(id) + " ";
+    }
+    return str;
+}
+
+void test_gguf_parse() {
+    auto path = fixture_path("parse");
+    auto writer = tiny_bert(bert_vocab);
+    std::string f16 = std::string("\x00\x3e\x00\xc0\x00\x34\x01\x00", 8); // 1.5, -2, 0.25, smallest subnormal
+    writer.add_tensor("f16", {4}, GGML_TYPE_F16, f16);
+    std::string q8_0 = std::string("\x00\x38", 2); // scale 0.5, then 32 x int8
+    for (int i = 0; i < 32; i++) {
+        q8_0 += static_cast<char>(i - 16);
+    }
+    writer.add_tensor("q8_0", {32}, GGML_TYPE_Q8_0, q8_0);
+    writer.write(path);
+
+    GGUFFile gguf;
+    gguf.load(path);
+    if (gguf.metadata.value("general.architecture", "") != "bert" || gguf.metadata.value("bert.feed_forward_length", 0) != n_ff) {
+        TEST_FAILED(__func__, "Unexpected metadata: " + gguf.metadata.dump());
+        return;
+    }
+    if (gguf.metadata["tokenizer.ggml.tokens"].size() != bert_vocab.size() || gguf.metadata["tokenizer.ggml.tokens"][5] != "##aff") {
+        TEST_FAILED(__func__, "Unexpected tokens: " + gguf.metadata["tokenizer.ggml.tokens"].dump());
+        return;
+    }
+    if (gguf.tensors.size() != 14 || gguf.data_offset % 32 != 0) {
+        TEST_FAILED(__func__, "Expected 14 tensors aligned to 32 bytes, got " + std::to_string(gguf.tensors.size()) + " at " + std::to_string(gguf.data_offset));
+        return;
+    }
+    const auto& info = gguf.tensors.at("token_embd.weight");
+    if (info.dims != std::vector<uint64_t>{n_embd, bert_vocab.size()} || info.type != GGML_TYPE_F32 || info.offset != 0) {
+        TEST_FAILED(__func__, "Unexpected tensor info of token_embd.weight");
+        return;
+    }
+    if (gguf.tensor("blk.0.ffn_down.weight", n_embd * n_ff) != weights(n_embd * n_ff, 8.0f)) {
+        TEST_FAILED(__func__, "Unexpected values of blk.0.ffn_down.weight");
+        return;
+    }
+    if (gguf.tensor("f16") != std::vector<float>{1.5f, -2.0f, 0.25f, std::ldexp(1.0f, -24)}) {
+        TEST_FAILED(__func__, "Unexpected values of the F16 tensor");
+        return;
+    }
+    auto q8_0_values = gguf.tensor("q8_0");
+    for (int i = 0; i < 32; i++) {
+        if (q8_0_values[i] != 0.5f * (i - 16)) {
+            TEST_FAILED(__func__, "Unexpected value " + std::to_string(q8_0_values[i]) + " at " + std::to_string(i) + " of the Q8_0 tensor");
+            return;
+        }
+    }
+
+    auto expect_error = [&](const std::string& content, const std::function<void(GGUFFile&)>& action, const std::string& what) {
+        std::ofstream(path, std::ios::binary | std::ios::trunc).write(content.data(), content.size());
+        try {
+            GGUFFile broken;
+            broken.load(path);
+            action(broken);
+        } catch (const std::runtime_error&) {
+            return true;
+        }
+        TEST_FAILED(__func__, "Expected an error for " + what);
+        return false;
+    };
+    auto content = writer.str();
+    auto nothing = [](GGUFFile&) {};
+    if (!expect_error("GGML" + content.substr(4), nothing, "a bad magic number")
+        || !expect_error(content.substr(0, gguf.data_offset - 40), nothing, "a truncated tensor table")
+        || !expect_error(content.substr(0, content.size() - 8), [](GGUFFile& g) { g.tensor("q8_0"); }, "a truncated tensor")
+        || !expect_error(content, [](GGUFFile& g) { g.tensor("f16", 5); }, "an unexpected number of elements")) {
+        return;
+    }
+    std::filesystem::remove(path);
+
+    TEST_PASSED(__func__);
+}
+
+void test_wordpiece() {
+    auto path = fixture_path("wordpiece");
+    tiny_bert(bert_vocab).write(path);
+    auto model = load_model(path);
+
+    std::vector<std::pair<std::string, std::vector<int>>> cases = {
+        {"UNaffable, hello worlds!", {2, 4, 5, 6, 9, 7, 8, 11, 10, 3}},
+        {"xyz\tplaying\n", {2, 1, 12, 13, 3}},            // Unknown word
+        {"你好", {2, 14, 15, 3}},                          // CJK characters are words of their own
+        {"hel\x01lo world", {2, 7, 8, 3}},                // Control characters are dropped (without splitting)
+        {"", {2, 3}}
+    };
+    for (const auto& [text, expected] : cases) {
+        auto tokens = model->tokenize(text);
+        if (tokens != expected) {
+            TEST_FAILED(__func__, "Expected " + to_string(expected) + "for \"" + text + "\", got " + to_string(tokens));
+            return;
+        }
+    }
+
+    std::string long_text;
+    for (int i = 0; i < 2 * n_ctx; i++) {
+        long_text += "hello ";
+    }
+    auto tokens = model->tokenize(long_text);
+    if (tokens.size() != n_ctx || tokens.front() != 2 || tokens.back() != 3 || tokens[n_ctx - 2] != 7) {
+        TEST_FAILED(__func__, "Expected " + std::to_string(n_ctx) + " tokens ending with [SEP], got " + to_string(tokens));
+        return;
+    }
+
+    // Vocabulary converted by llama.cpp: word starts marked with "▁" instead of continuations with "##"
+    tiny_bert({"[PAD]", "[UNK]", "[CLS]", "[SEP]", "\xe2\x96\x81un", "aff", "able", "\xe2\x96\x81hello"}).write(path);
+    tokens = load_model(path)->tokenize("unaffable hello affable");
+    if (tokens != std::vector<int>{2, 4, 5, 6, 7, 1, 3}) {
+        TEST_FAILED(__func__, "Unexpected tokens from a phantom space vocabulary: " + to_string(tokens));
+        return;
+    }
+    std::filesystem::remove(path);
+
+    TEST_PASSED(__func__);
+}
+
+void test_embed() {
+    auto path = fixture_path("embed");
+    tiny_bert(bert_vocab).write(path);
+    auto model = load_model(path);
+
+    auto embedding = model->embed("hello world", EmbeddingType::ADD);
+    if (embedding.size() != n_embd) {
+        TEST_FAILED(__func__, "Expected " + std::to_string(n_embd) + " dimensions, got " + std::to_string(embedding.size()));
+        return;
+    }
+    for (auto x : embedding) {
+        if (!std::isfinite(x)) {
+            TEST_FAILED(__func__, "Expected finite values");
+            return;
+        }
+    }
+    if (model->embed("hello world", EmbeddingType::SEARCH) != embedding || model->embed("world hello", EmbeddingType::ADD) == embedding) {
+        TEST_FAILED(__func__, "Expected embeddings to depend on the text (and the token order) only");
+        return;
+    }
+    std::filesystem::remove(path);
+
+    TEST_PASSED(__func__);
+}
+
+int main() {
+    try {
+        test_gguf_parse();
+
+        test_wordpiece();
+
+        test_embed();
+    } catch (const std::exception& e) {
+        TEST_FAILED("test_local_embedding", "Error: " + std::string(e.what()));
+    }
+    return num_failed > 0 ? 1 : 0;
+}
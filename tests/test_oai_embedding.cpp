@@ -0,0 +1,140 @@
+#include "../memory/embedding_model/oai.h"
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace humanus;
+
+static int num_failed = 0;
+
+#define TEST_FAILED(func, message) do { std::cout << func << " \033[31mfailed\033[0m " << message << std::endl; num_failed++; } while (0)
+#define TEST_PASSED(func) std::cout << func << " \033[32mpassed\033[0m" << std::endl
+
+// Little-endian float32 values as the API encodes them with `encoding_format = "base64"`
+static std::string encode_base64(const std::vector<float>& values) {
+    const char* chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string bytes(values.size() * sizeof(float), '\0');
+    std::memcpy(bytes.data(), values.data(), bytes.size());
+    std::string encoded;
+    for (size_t i = 0; i < bytes.size(); i += 3) {
+        uint32_t n = static_cast<unsigned char>(bytes[i]) << 16;
+        if (i + 1 < bytes.size()) n |= static_cast<unsigned char>(bytes[i + 1]) << 8;
+        if (i + 2 < bytes.size()) n |= static_cast<unsigned char>(bytes[i + 2]);
+        encoded += chars[(n >> 18) & 63];
+        encoded += chars[(n >> 12) & 63];
+        encoded += i + 1 < bytes.size() ? chars[(n >> 6) & 63] : '=';
+        encoded += i + 2 < bytes.size() ? chars[n & 63] : '=';
+    }
+    return encoded;
+}
+
+static std::string item(const std::string& embedding, size_t index) {
+    return "{\"object\": \"embedding\", \"embedding\": " + embedding + ", \"index\": " + std::to_string(index) + "}";
+}
+
+static std::string response(const std::vector<std::string>& items) {
+    std::string data;
+    for (const auto& item : items) {
+        data += (data.empty() ? "" : ",\n    ") + item;
+    }
+    return "{\"object\": \"list\", \"data\": [\n    " + data + "\n], \"model\": \"embedding\", \"usage\": {\"prompt_tokens\": 4, \"total_tokens\": 4}}";
+}
+
+static std::string to_string(const std::vector<std::vector<float>>& embeddings) {
+    std::string str;
+    for (const auto& embedding : embeddings) {
+        str += "[";
+        for (auto x : embedding) {
+            str += std::to_string(x) + " ";
+        }
+        str += "]";
+    }
+    return str;
+}
+
+static bool expect_embeddings(const char* func, const std::string& body, const std::vector<std::vector<float>>& expected) {
+    std::vector<std::vector<float>> embeddings;
+    if (!OAIEmbeddingModel::parse_embeddings(body, expected.size(), embeddings, 3)) {
+        TEST_FAILED(func, "Failed to parse " + body);
+        return false;
+    }
+    if (embeddings != expected) {
+        TEST_FAILED(func, "Expected " + to_string(expected) + ", got " + to_string(embeddings) + " from " + body);
+        return false;
+    }
+    return true;
+}
+
+void test_float_array() {
+    std::vector<std::vector<float>> expected = {{0.5f, -1.25e-3f, 3.0f}, {1e-20f, -0.0f, 123456.789f}};
+    if (!expect_embeddings(__func__, response({item("[0.5, -1.25e-3, 3]", 0), item("[ 1e-20 ,-0.0,\n123456.789 ]", 1)}), expected)) {
+        return;
+    }
+    if (!expect_embeddings(__func__, "{\"data\":[{\"embedding\":[]}]}", {{}})) { // Compact, without "index"
+        return;
+    }
+
+    TEST_PASSED(__func__);
+}
+
+void test_base64() {
+    std::vector<std::vector<float>> expected = {{1.5f, -2.0f, 0.1f}, {3.14159f}, {1.0f, 2.0f}};
+    std::vector<std::string> items;
+    for (size_t i = 0; i < expected.size(); i++) { // 12, 4 and 8 bytes: no padding, "==" and "="
+        items.push_back(item("\"" + encode_base64(expected[i]) + "\"", i));
+    }
+    if (!expect_embeddings(__func__, response(items), expected)) {
+        return;
+    }
+
+    TEST_PASSED(__func__);
+}
+
+void test_out_of_order() {
+    std::vector<std::vector<float>> expected = {{0.0f}, {1.0f}, {2.0f}, {3.0f}};
+    auto body = response({
+        item("[2]", 2),
+        "{\"index\": 0, \"object\": \"embedding\", \"embedding\": \"" + encode_base64({0.0f}) + "\"}", // "index" before "embedding"
+        item("[3]", 3),
+        item("[1]", 1)
+    });
+    if (!expect_embeddings(__func__, body, expected)) {
+        return;
+    }
+
+    TEST_PASSED(__func__);
+}
+
+void test_unexpected_layout() {
+    std::vector<std::pair<std::string, std::string>> cases = {
+        {"missing embedding", response({item("[1]", 0)})},
+        {"duplicate index", response({item("[1]", 0), item("[2]", 0)})},
+        {"index out of range", response({item("[1]", 0), item("[2]", 2)})},
+        {"invalid number", response({item("[1, x]", 0), item("[2]", 1)})},
+        {"unterminated array", "{\"data\": [{\"embedding\": [1, 2"},
+        {"invalid base64", response({item("\"AAAA!AAA\"", 0), item("[2]", 1)})},
+        {"partial float in base64", response({item("\"AAAAAAA=\"", 0), item("[2]", 1)})}
+    };
+    for (const auto& [what, body] : cases) {
+        std::vector<std::vector<float>> embeddings;
+        if (OAIEmbeddingModel::parse_embeddings(body, 2, embeddings, 3)) {
+            TEST_FAILED(__func__, "Expected " + what + " to be rejected: " + body);
+            return;
+        }
+    }
+
+    TEST_PASSED(__func__);
+}
+
+int main() {
+    test_float_array();
+
+    test_base64();
+
+    test_out_of_order();
+
+    test_unexpected_layout();
+
+    return num_failed > 0 ? 1 : 0;
+}
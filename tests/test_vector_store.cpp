@@ -0,0 +1,600 @@
+#include "../memory/vector_store/hnswlib.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace humanus;
+
+static int num_failed = 0;
+
+#define TEST_FAILED(func, message) do { std::cout << func << " \033[31mfailed\033[0m " << message << std::endl; num_failed++; } while (0)
+#define TEST_PASSED(func) std::cout << func << " \033[32mpassed\033[0m" << std::endl
+
+static std::vector<float> random_vector(std::mt19937& rng, int dim) {
+    std::normal_distribution<float> dist;
+    std::vector<float> vector(dim);
+    for (auto& x : vector) {
+        x = dist(rng);
+    }
+    return vector;
+}
+
+// Empty directory for a persistent store
+static std::string store_path(const std::string& name) {
+    auto path = std::filesystem::temp_directory_path() / ("humanus_test_vector_store_" + name);
+    std::filesystem::remove_all(path);
+    return path.string();
+}
+
+void test_growth() {
+    auto config = std::make_shared<VectorStoreConfig>();
+    config->dim = 8;
+    config->max_elements = 100;
+    config->memory_budget_mb = 64;
+
+    std::mt19937 rng(1);
+    HNSWLibVectorStore store(config);
+    for (size_t i = 1; i <= 150; i++) {
+        store.insert(random_vector(rng, config->dim), i, MemoryItem(i, "memory " + std::to_string(i)));
+    }
+    if (store.list(0).size() != 150) {
+        TEST_FAILED(__func__, "Expected the store to grow past max_elements, got " + std::to_string(store.list(0).size()) + " memories");
+        return;
+    }
+
+    for (size_t i = 1; i <= 100; i++) { // Slots of removed memories are reused
+        store.remove(i);
+        store.insert(random_vector(rng, config->dim), 150 + i, MemoryItem(150 + i, "memory " + std::to_string(150 + i)));
+    }
+    auto memories = store.list(0);
+    if (memories.size() != 150 || store.get(250).memory != "memory 250") {
+        TEST_FAILED(__func__, "Expected memories 101 to 250, got " + std::to_string(memories.size()) + " memories");
+        return;
+    }
+    for (const auto& item : memories) {
+        if (item.id <= 100) {
+            TEST_FAILED(__func__, "Expected memory " + std::to_string(item.id) + " to be removed");
+            return;
+        }
+    }
+
+    TEST_PASSED(__func__);
+}
+
+void test_batch_eviction() {
+    auto config = std::make_shared<VectorStoreConfig>();
+    config->dim = 8;
+    config->max_elements = 10; // No memory budget to grow into
+
+    std::mt19937 rng(7);
+    HNSWLibVectorStore store(config);
+    for (size_t i = 1; i <= 10; i++) {
+        store.insert(random_vector(rng, config->dim), i, MemoryItem(i, "memory " + std::to_string(i)));
+    }
+
+    // 1 and 2 are the next eviction victims, they must make room for neither 11 nor 12
+    std::vector<std::vector<float>> vectors;
+    std::vector<MemoryItem> metadatas;
+    std::vector<size_t> vector_ids = {1, 11, 2, 12};
+    for (auto id : vector_ids) {
+        vectors.push_back(random_vector(rng, config->dim));
+        metadatas.push_back(MemoryItem(id, "batch " + std::to_string(id)));
+    }
+    store.insert_batch(vectors, vector_ids, metadatas);
+
+    std::map<size_t, std::string> memories;
+    for (const auto& item : store.list(0)) {
+        memories[item.id] = item.memory;
+    }
+    if (memories.size() != 10) {
+        TEST_FAILED(__func__, "Expected the store to stay full, got " + std::to_string(memories.size()) + " memories");
+        return;
+    }
+    for (auto id : vector_ids) {
+        if (memories[id] != "batch " + std::to_string(id)) {
+            TEST_FAILED(__func__, "Expected memory " + std::to_string(id) + " of the batch to be stored");
+            return;
+        }
+    }
+
+    TEST_PASSED(__func__);
+}
+
+void test_reload_after_growth() {
+    for (int snapshot_interval : {1024, 40}) { // Replayed from the log only, and from a grown snapshot plus the log
+        auto config = std::make_shared<VectorStoreConfig>();
+        config->dim = 8;
+        config->max_elements = 100;
+        config->memory_budget_mb = 64;
+        config->path = store_path("growth");
+        config->snapshot_interval = snapshot_interval;
+
+        std::mt19937 rng(1);
+        {
+            HNSWLibVectorStore store(config);
+            for (size_t i = 1; i <= 150; i++) {
+                store.insert(random_vector(rng, config->dim), i, MemoryItem(i, "memory " + std::to_string(i)));
+            }
+            if (store.list(0).size() != 150) {
+                TEST_FAILED(__func__, "Expected 150 memories before restarting, got " + std::to_string(store.list(0).size()));
+                return;
+            }
+        }
+
+        HNSWLibVectorStore store(config);
+        if (store.list(0).size() != 150) {
+            TEST_FAILED(__func__, "Expected 150 memories after restarting, got " + std::to_string(store.list(0).size()));
+            return;
+        }
+        if (store.get(150).memory != "memory 150") {
+            TEST_FAILED(__func__, "Expected \"memory 150\", got \"" + store.get(150).memory + "\"");
+            return;
+        }
+        std::filesystem::remove_all(config->path);
+    }
+
+    TEST_PASSED(__func__);
+}
+
+static std::shared_ptr<VectorStoreConfig> persistent_config(const std::string& name, int snapshot_interval) {
+    auto config = std::make_shared<VectorStoreConfig>();
+    config->dim = 8;
+    config->max_elements = 100;
+    config->path = store_path(name);
+    config->snapshot_interval = snapshot_interval;
+    return config;
+}
+
+// Offsets of the records in a write-ahead log (payload size and checksum, then the payload)
+static std::vector<size_t> log_records(const std::string& wal) {
+    std::vector<size_t> offsets;
+    size_t pos = 0;
+    while (pos + 2 * sizeof(uint32_t) <= wal.size()) {
+        offsets.push_back(pos);
+        uint32_t size;
+        std::memcpy(&size, wal.data() + pos, sizeof(size));
+        pos += 2 * sizeof(uint32_t) + size;
+    }
+    return offsets;
+}
+
+static std::string read_wal(const std::string& path) {
+    std::ifstream file(std::filesystem::path(path) / "wal.log", std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void write_wal(const std::string& path, const std::string& wal) {
+    std::ofstream file(std::filesystem::path(path) / "wal.log", std::ios::binary | std::ios::trunc);
+    file.write(wal.data(), wal.size());
+}
+
+static void insert_memories(const std::shared_ptr<VectorStoreConfig>& config, size_t count) {
+    std::mt19937 rng(2);
+    HNSWLibVectorStore store(config);
+    for (size_t i = 1; i <= count; i++) {
+        store.insert(random_vector(rng, config->dim), i, MemoryItem(i, "memory " + std::to_string(i)));
+    }
+}
+
+void test_log_checksum() {
+    auto config = persistent_config("checksum", 1024);
+    insert_memories(config, 10);
+
+    std::string wal = read_wal(config->path);
+    auto offsets = log_records(wal);
+    if (offsets.size() != 10) {
+        TEST_FAILED(__func__, "Expected 10 log records, got " + std::to_string(offsets.size()));
+        return;
+    }
+    wal[offsets[5] + 2 * sizeof(uint32_t) + 20] ^= 0x5a; // Inside the payload of the 6th record
+    write_wal(config->path, wal);
+
+    HNSWLibVectorStore store(config);
+    if (store.list(0).size() != 5) {
+        TEST_FAILED(__func__, "Expected replay to stop before the corrupted record, got " + std::to_string(store.list(0).size()) + " memories");
+        return;
+    }
+    if (read_wal(config->path).size() != offsets[5]) {
+        TEST_FAILED(__func__, "Expected the log to be truncated to " + std::to_string(offsets[5]) + " bytes");
+        return;
+    }
+    std::filesystem::remove_all(config->path);
+
+    TEST_PASSED(__func__);
+}
+
+void test_torn_tail() {
+    auto config = persistent_config("torn", 1024);
+    insert_memories(config, 10);
+
+    std::string wal = read_wal(config->path);
+    auto offsets = log_records(wal);
+    for (size_t cut : {size_t(3), wal.size() - offsets[9] - 5}) { // Torn payload, torn header
+        write_wal(config->path, wal.substr(0, wal.size() - cut));
+        {
+            HNSWLibVectorStore store(config);
+            if (store.list(0).size() != 9) {
+                TEST_FAILED(__func__, "Expected 9 memories from a torn log, got " + std::to_string(store.list(0).size()));
+                return;
+            }
+        }
+        if (read_wal(config->path).size() != offsets[9]) {
+            TEST_FAILED(__func__, "Expected the torn record to be truncated");
+            return;
+        }
+    }
+    std::filesystem::remove_all(config->path);
+
+    TEST_PASSED(__func__);
+}
+
+// Inserts, removes, updates and re-sets memories, the same for every call
+static void apply_operations(HNSWLibVectorStore& store, int dim) {
+    std::mt19937 rng(3);
+    for (size_t i = 1; i <= 60; i++) {
+        MemoryItem item(i, "memory " + std::to_string(i));
+        item.tenant = i % 3 == 0 ? "alice" : "bob";
+        item.tags = {"tag" + std::to_string(i % 4)};
+        item.created_at = item.updated_at = i;
+        store.insert(random_vector(rng, dim), i, item);
+    }
+    for (size_t i = 1; i <= 60; i += 5) {
+        store.remove(i);
+    }
+    for (size_t i = 2; i <= 60; i += 7) {
+        if (i % 5 == 1) { // Removed
+            continue;
+        }
+        store.update(i, random_vector(rng, dim));
+    }
+    for (size_t i = 3; i <= 60; i += 11) {
+        MemoryItem item(i, "renamed " + std::to_string(i));
+        item.tenant = "carol";
+        item.created_at = item.updated_at = i;
+        store.set(i, item);
+    }
+}
+
+static std::string describe(HNSWLibVectorStore& store, const std::vector<std::vector<float>>& queries) {
+    std::map<size_t, std::string> memories;
+    for (const auto& item : store.list(0)) {
+        std::string tags;
+        for (const auto& tag : item.tags) {
+            tags += tag + ",";
+        }
+        memories[item.id] = item.memory + "|" + item.tenant + "|" + tags + "|" + std::to_string(item.created_at);
+    }
+    std::string description;
+    for (const auto& [id, memory] : memories) {
+        description += std::to_string(id) + ":" + memory + "\n";
+    }
+    for (const auto& query : queries) {
+        for (const auto& item : store.search(query, 5)) {
+            description += std::to_string(item.id) + " ";
+        }
+        description += "\n";
+    }
+    return description;
+}
+
+void test_snapshot_replay_equivalence() {
+    std::mt19937 rng(4);
+    std::vector<std::vector<float>> queries;
+    for (int i = 0; i < 10; i++) {
+        queries.push_back(random_vector(rng, 8));
+    }
+
+    for (std::string provider : {"hnswlib", "hnswlib_mmap", "bruteforce"}) { // Each loads its own index kind from the mapped snapshot
+        std::string expected;
+        for (int snapshot_interval : {100000, 7, 1}) { // Log only, snapshots plus log, snapshot after every operation
+            auto config = persistent_config("equivalence", snapshot_interval);
+            config->provider = provider;
+            std::string before;
+            {
+                HNSWLibVectorStore store(config);
+                apply_operations(store, config->dim);
+                before = describe(store, queries);
+            }
+            HNSWLibVectorStore store(config);
+            std::string after = describe(store, queries);
+            if (after != before) {
+                TEST_FAILED(__func__, "Store differs after restarting " + provider + " with snapshot_interval " + std::to_string(snapshot_interval));
+                return;
+            }
+            if (expected.empty()) {
+                expected = after;
+            } else if (after != expected) {
+                TEST_FAILED(__func__, "Snapshot of " + provider + " with interval " + std::to_string(snapshot_interval) + " differs from replaying the log");
+                return;
+            }
+            std::filesystem::remove_all(config->path);
+        }
+    }
+
+    TEST_PASSED(__func__);
+}
+
+void test_snapshot_after_reset() {
+    auto config = persistent_config("reset", 5);
+    insert_memories(config, 10); // Snapshot after the 10th operation, nothing logged since
+    auto dir = std::filesystem::path(config->path);
+
+    std::ifstream current_file(dir / "CURRENT");
+    std::string current((std::istreambuf_iterator<char>(current_file)), std::istreambuf_iterator<char>());
+    {
+        HNSWLibVectorStore store(config);
+        store.reset();
+    }
+
+    std::ifstream new_current_file(dir / "CURRENT");
+    std::string new_current((std::istreambuf_iterator<char>(new_current_file)), std::istreambuf_iterator<char>());
+    if (new_current == current) {
+        TEST_FAILED(__func__, "Expected the snapshot of the reset store to be written to new files");
+        return;
+    }
+    if (!std::filesystem::exists(dir / (new_current + ".index")) || std::filesystem::exists(dir / (current + ".index"))) {
+        TEST_FAILED(__func__, "Expected only the files of the latest snapshot");
+        return;
+    }
+
+    HNSWLibVectorStore store(config);
+    if (!store.list(0).empty()) {
+        TEST_FAILED(__func__, "Expected an empty store after reset, got " + std::to_string(store.list(0).size()) + " memories");
+        return;
+    }
+    std::filesystem::remove_all(config->path);
+
+    TEST_PASSED(__func__);
+}
+
+// Random memories in an in-memory graph, built with a small candidate list so that searches with a small `ef` miss neighbors
+static std::shared_ptr<VectorStoreConfig> graph_config(int ef_search, float recall_target) {
+    auto config = std::make_shared<VectorStoreConfig>();
+    config->dim = 16;
+    config->max_elements = 2000;
+    config->M = 4;
+    config->ef_construction = 20;
+    config->ef_search = ef_search;
+    config->recall_target = recall_target;
+    config->recall_sample_interval = 1;
+    return config;
+}
+
+static std::vector<std::vector<float>> fill(HNSWLibVectorStore& store, size_t count, int dim) {
+    std::mt19937 rng(5);
+    std::vector<std::vector<float>> vectors;
+    for (size_t i = 1; i <= count; i++) {
+        vectors.push_back(random_vector(rng, dim));
+        store.insert(vectors.back(), i, MemoryItem(i, "memory " + std::to_string(i)));
+    }
+    return vectors;
+}
+
+// Ids of the `k` nearest neighbors of `query` (squared L2) among `vectors`, stored as ids 1, 2, ...
+static std::vector<size_t> exact_neighbors(const std::vector<std::vector<float>>& vectors, const std::vector<float>& query, size_t k) {
+    std::vector<std::pair<float, size_t>> distances;
+    for (size_t i = 0; i < vectors.size(); i++) {
+        float distance = 0;
+        for (size_t j = 0; j < query.size(); j++) {
+            distance += (vectors[i][j] - query[j]) * (vectors[i][j] - query[j]);
+        }
+        distances.emplace_back(distance, i + 1);
+    }
+    std::partial_sort(distances.begin(), distances.begin() + k, distances.end());
+    std::vector<size_t> ids;
+    for (size_t i = 0; i < k; i++) {
+        ids.push_back(distances[i].second);
+    }
+    return ids;
+}
+
+// Recall@k of searching `queries` with candidate list `ef` (0 for the configured one)
+static float recall(HNSWLibVectorStore& store, const std::vector<std::vector<float>>& vectors, const std::vector<std::vector<float>>& queries, size_t k, size_t ef) {
+    size_t found = 0;
+    for (const auto& query : queries) {
+        auto exact = exact_neighbors(vectors, query, k);
+        for (const auto& item : store.search(query, k, nullptr, ef)) {
+            found += std::count(exact.begin(), exact.end(), item.id);
+        }
+    }
+    return static_cast<float>(found) / (queries.size() * k);
+}
+
+void test_tune_ef_search() {
+    std::mt19937 rng(6);
+    std::vector<std::vector<float>> queries;
+    for (int i = 0; i < 320; i++) { // 10 tuning windows
+        queries.push_back(random_vector(rng, 16));
+    }
+
+    {
+        HNSWLibVectorStore store(graph_config(10, 0.99f));
+        auto vectors = fill(store, 2000, 16);
+        float before = recall(store, vectors, queries, 10, 10); // Per query `ef`, not sampled
+        for (const auto& query : queries) {
+            store.search(query, 10);
+        }
+        if (store.ef_search() <= 10) {
+            TEST_FAILED(__func__, "Expected ef_search to grow towards recall 0.99 from " + std::to_string(before) + ", got " + std::to_string(store.ef_search()));
+            return;
+        }
+        if (recall(store, vectors, queries, 10, 0) <= before) {
+            TEST_FAILED(__func__, "Expected a higher recall with the tuned ef_search " + std::to_string(store.ef_search()));
+            return;
+        }
+    }
+
+    {
+        HNSWLibVectorStore store(graph_config(1000, 0.5f));
+        fill(store, 2000, 16);
+        for (const auto& query : queries) {
+            store.search(query, 10);
+        }
+        if (store.ef_search() >= 1000 || store.ef_search() < 10) {
+            TEST_FAILED(__func__, "Expected ef_search to shrink while the recall stays above 0.5, got " + std::to_string(store.ef_search()));
+            return;
+        }
+    }
+
+    for (float recall_target : {0.0f, 0.99f}) { // Disabled, or only searches with a per query `ef`
+        HNSWLibVectorStore store(graph_config(10, recall_target));
+        fill(store, 2000, 16);
+        for (const auto& query : queries) {
+            store.search(query, 10, nullptr, recall_target > 0 ? 10 : 0);
+        }
+        if (store.ef_search() != 10) {
+            TEST_FAILED(__func__, "Expected ef_search to stay at 10 with recall_target " + std::to_string(recall_target) + ", got " + std::to_string(store.ef_search()));
+            return;
+        }
+    }
+
+    TEST_PASSED(__func__);
+}
+
+void test_per_query_ef() {
+    std::mt19937 rng(7);
+    std::vector<std::vector<float>> queries;
+    for (int i = 0; i < 50; i++) {
+        queries.push_back(random_vector(rng, 16));
+    }
+
+    HNSWLibVectorStore store(graph_config(10, 0.0f));
+    auto vectors = fill(store, 2000, 16);
+    float configured = recall(store, vectors, queries, 10, 0);
+    float exhaustive = recall(store, vectors, queries, 10, 2000);
+    if (exhaustive < 0.99f || exhaustive <= configured) {
+        TEST_FAILED(__func__, "Expected ef 2000 (recall " + std::to_string(exhaustive) + ") to beat the configured ef_search 10 (recall " + std::to_string(configured) + ")");
+        return;
+    }
+
+    auto batch = store.search_batch(queries, 10, nullptr, 2000);
+    for (size_t i = 0; i < queries.size(); i++) {
+        if (batch[i].size() != 10 || batch[i].front().id != store.search(queries[i], 10, nullptr, 2000).front().id) {
+            TEST_FAILED(__func__, "Expected search_batch to use the per query ef");
+            return;
+        }
+    }
+    if (store.ef_search() != 10 || recall(store, vectors, queries, 10, 0) != configured) {
+        TEST_FAILED(__func__, "Expected searches without ef to keep using ef_search 10");
+        return;
+    }
+
+    TEST_PASSED(__func__);
+}
+
+void test_contains_hash() {
+    auto config = persistent_config("hash", 1024);
+    auto contains = [](HNSWLibVectorStore& store, const std::string& memory) {
+        return store.contains_hash(MemoryItem(0, memory).hash);
+    };
+
+    std::mt19937 rng(5);
+    {
+        HNSWLibVectorStore store(config);
+        for (size_t i = 1; i <= 10; i++) {
+            store.insert(random_vector(rng, config->dim), i, MemoryItem(i, "memory " + std::to_string(i)));
+        }
+        store.insert(random_vector(rng, config->dim), 11, MemoryItem(11, "memory 3")); // Same content twice
+        store.update(1, {}, MemoryItem(1, "changed"));
+        store.remove(2);
+        store.remove(3);
+        if (!contains(store, "changed") || contains(store, "memory 1") || contains(store, "memory 2") || !contains(store, "memory 3")) {
+            TEST_FAILED(__func__, "Expected hashes to follow updates and removals");
+            return;
+        }
+    }
+    HNSWLibVectorStore store(config); // Rebuilt from the log
+    if (!contains(store, "changed") || !contains(store, "memory 10") || contains(store, "memory 2") || !contains(store, "memory 3")) {
+        TEST_FAILED(__func__, "Expected hashes to be restored on reload");
+        return;
+    }
+    store.reset();
+    if (contains(store, "changed")) {
+        TEST_FAILED(__func__, "Expected no hashes after reset");
+        return;
+    }
+    std::filesystem::remove_all(config->path);
+
+    TEST_PASSED(__func__);
+}
+
+void test_writers_not_starved() {
+    auto config = std::make_shared<VectorStoreConfig>();
+    config->dim = 8;
+    config->max_elements = 1000;
+
+    std::mt19937 rng(6);
+    HNSWLibVectorStore store(config);
+    fill(store, 500, config->dim);
+
+    std::atomic<bool> stop{false};
+    std::atomic<size_t> num_searches{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++) { // Overlapping shared locks, never all released at once
+        readers.emplace_back([&, t] {
+            std::mt19937 rng(100 + t);
+            while (!stop.load()) {
+                store.search(random_vector(rng, config->dim), 10);
+                num_searches++;
+            }
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 1; i <= 50; i++) {
+        store.insert(random_vector(rng, config->dim), 1000 + i, MemoryItem(1000 + i, "memory"));
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    stop = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+    if (elapsed > std::chrono::seconds(10) || store.list(0).size() != 550) {
+        TEST_FAILED(__func__, "Expected inserts to get through concurrent searches");
+        return;
+    }
+    if (num_searches == 0) {
+        TEST_FAILED(__func__, "Expected searches to run concurrently with inserts");
+        return;
+    }
+
+    TEST_PASSED(__func__);
+}
+
+int main() {
+    try {
+        test_growth();
+
+        test_batch_eviction();
+
+        test_reload_after_growth();
+
+        test_log_checksum();
+
+        test_torn_tail();
+
+        test_snapshot_replay_equivalence();
+
+        test_snapshot_after_reset();
+
+        test_tune_ef_search();
+
+        test_per_query_ef();
+
+        test_contains_hash();
+
+        test_writers_not_starved();
+    } catch (const std::exception& e) {
+        TEST_FAILED("test_vector_store", "Error: " + std::string(e.what()));
+    }
+    return num_failed > 0 ? 1 : 0;
+}